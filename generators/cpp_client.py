@@ -210,6 +210,8 @@ def c_open(self):
     _h('')
     _h('#include <string>')
     _h('#include <vector>')
+    _h('#include <cstdlib>')
+    _h('#include <utility>')
     _h('')
 
     _h('#include <xcb/' + _get_xcb_include(_ns.header.lower()) + '>')
@@ -234,7 +236,7 @@ def c_close(self):
     '''
 
     _h('')
-    _h(ExtensionClass(_ns).make_class())
+    _h(ExtensionClass(_ns, _cpp_request_objects.get('query_version')).make_class())
 
 
     for cpp_event in _cpp_events:
@@ -3004,7 +3006,8 @@ def cpp_event(self, name):
     opcode = _n(name).upper()
     c_name = _t(self.name + ('event',))
 
-    cpp_event = CppEvent(self.opcodes[name], opcode, c_name, _ns, name, self.fields)
+    cpp_event = CppEvent(self.opcodes[name], opcode, c_name, _ns, name, self.fields,
+                         getattr(self, 'is_ge_event', False))
     _cpp_events.append(cpp_event)
     _interface_class.add_event(cpp_event)
 
@@ -1,4 +1,4 @@
-from utils import _n, _ext, _n_item, get_namespace
+from utils import _n, _ext, _n_item, get_namespace, get_request_info, get_request_size
 
 _templates = {}
 
@@ -8,35 +8,41 @@ _templates['void_cookie_function'] = \
 void
 %s_checked(Connection && c%s)
 {%s\
+  const xpp::generic::request_info request =
+    %s;
+  const xcb_void_cookie_t cookie = %s_checked(c%s);
+  xpp::generic::sent(c, request);
   xpp::generic::check<Connection, xpp::%s::error::dispatcher>(
-      std::forward<Connection>(c),
-      %s_checked(std::forward<Connection>(c)%s));
+      std::forward<Connection>(c), cookie, request);
 }
 
 %s\
 void
 %s(Connection && c%s)
 {%s\
-  %s(std::forward<Connection>(c)%s);
+  %s(c%s);
+  xpp::generic::sent(c, %s);
 }
 '''
 
-def _void_cookie_function(ns, name, c_name, template, return_value, protos, calls, initializer):
+def _void_cookie_function(ns, name, c_name, request_info, template, return_value, protos, calls, initializer):
     if len(template) == 0: template = "template<typename Connection>\n"
     return _templates['void_cookie_function'] % \
             ( template
             , name
             , protos
             , initializer
-            , ns
+            , request_info
             , c_name
             , calls
+            , ns
             , template
             , name
             , protos
             , initializer
             , c_name
             , calls
+            , request_info
             )
 
 _templates['cookie_static_getter'] = \
@@ -98,7 +104,8 @@ class CppCookie(object):
     def iterator_initializers(self):
         return self.parameter_list.iterator_initializers()
 
-    def void_functions(self, protos, calls, template="", initializer=[]):
+    # call_params: the arguments of the xcb request function
+    def void_functions(self, protos, calls, call_params, template="", initializer=[]):
         inits = "" if len(initializer) > 0 else "\n"
         for i in initializer:
             inits += "\n"
@@ -107,9 +114,13 @@ class CppCookie(object):
 
         return_value = "xcb_void_cookie_t"
 
+        size = get_request_size(self.c_name, self.parameter_list.parameter,
+                                call_params)
+
         return _void_cookie_function(get_namespace(self.namespace),
                                      self.request_name,
                                      self.c_name,
+                                     get_request_info(self.namespace, self.c_name, size),
                                      template,
                                      return_value,
                                      self.comma() + protos,
@@ -168,23 +179,25 @@ class CppCookie(object):
         return result
 
     def make_void_functions(self):
-        default = self.void_functions(self.protos(False, False), self.calls(False))
+        parameter = self.parameter_list.parameter
+        default = self.void_functions(self.protos(False, False), self.calls(False), parameter)
 
         if self.parameter_list.has_defaults:
-            default = self.void_functions(self.protos(True, True), self.calls(False))
+            default = self.void_functions(self.protos(True, True), self.calls(False), parameter)
 
         wrapped = ""
         if self.parameter_list.want_wrap:
             wrapped = \
                 self.void_functions(self.iterator_protos(True, True),
                         self.iterator_calls(False),
+                        self.parameter_list.iter_calls,
                         self.iterator_template(indent=""),
                         self.iterator_initializers())
 
         default_args = ""
         if self.parameter_list.is_reordered():
             default_args = \
-                self.void_functions(self.protos(True, True), self.calls(False))
+                self.void_functions(self.protos(True, True), self.calls(False), parameter)
 
         result = ""
 
@@ -46,6 +46,26 @@ def _field_accessor_template(c_type, method_name, member):
         , member
         )
 
+_templates['window_id'] = \
+'''\
+    xcb_window_t
+    window_id(void) const
+    {
+      return (*this)->%s;
+    }\
+'''
+
+# fields which xpp::event::registry uses to route an event to a window,
+# in order of preference
+_window_fields = [ "window", "event" ]
+
+def _window_id(fields):
+    for name in _window_fields:
+        for field in fields:
+            if field.field_name == name and field.field_type[-1] == "WINDOW":
+                return _templates['window_id'] % field.c_field_name
+    return None
+
 _templates['event_dispatcher_class'] = \
 '''\
 namespace event {
@@ -60,7 +80,7 @@ class dispatcher
     template<typename Handler>
     bool
     operator()(Handler%s,
-               const std::shared_ptr<xcb_generic_event_t> &%s) const
+               const xpp::generic::event_ptr &%s) const
     {\
 %s
       return false;
@@ -72,6 +92,17 @@ class dispatcher
 } // namespace event
 '''
 
+_templates['event_dispatcher_ge'] = \
+'''
+      if ((event->response_type & ~0x80) == XCB_GE_GENERIC) {
+        auto * ge = reinterpret_cast<const xcb_ge_generic_event_t *>(event.get());
+        if (ge->extension == m_major_opcode) {\
+%s
+        }
+        return false;
+      }
+'''
+
 def _event_dispatcher_class(typedef, ctors, switch, members, has_events):
     return _templates['event_dispatcher_class'] % \
         ( typedef
@@ -114,18 +145,23 @@ def event_dispatcher_class(namespace, cppevents):
         else:
             opcode_switch = "(event->response_type & ~0x80) - m_first_event"
 
-        members += [ "  uint8_t m_first_event;" ]
+        members += [ "  uint8_t m_first_event;"
+                   , "  uint8_t m_major_opcode;"
+                   ]
 
         ctors = \
             [ "template<typename C>"
-            , "%s(C && c, uint8_t first_event)" % (ctor_name)
+            , "%s(C && c, uint8_t first_event, uint8_t major_opcode = 0)" % (ctor_name)
             , "  : m_c(std::forward<C>(c))"
             , "  , m_first_event(first_event)"
+            , "  , m_major_opcode(major_opcode)"
             , "{}"
             , ""
             , "template<typename C>"
             , "%s(C && c, const xpp::%s::extension & extension)" % (ctor_name, ns)
-            , "  : %s(std::forward<C>(c), extension->first_event)" % ctor_name
+            , "  : %s(std::forward<C>(c)," % ctor_name
+            , "     " + (" " * len(ctor_name)) + "extension->first_event,"
+            , "     " + (" " * len(ctor_name)) + "extension->major_opcode)"
             , "{}"
             ]
 
@@ -146,13 +182,25 @@ def event_dispatcher_class(namespace, cppevents):
     else:
         members = ""
 
-    switch = event_switch_cases(cppevents, opcode_switch, "handler", "event", namespace)
+    # XGE events all share the response type XCB_GE_GENERIC and are told apart
+    # by the major opcode of the extension and their event type
+    ge_events = [e for e in cppevents if namespace.is_ext and e.is_ge_event]
+    cppevents = [e for e in cppevents if e not in ge_events]
+
+    switch = ""
+    if len(ge_events) > 0:
+        ge_switch = event_switch_cases(ge_events, "ge->event_type", "handler", "event", namespace)
+        switch = _templates['event_dispatcher_ge'] % \
+            "\n".join(map(lambda s: ("    " if len(s) > 0 else "") + s,
+                          ge_switch.split("\n")))
+
+    switch += event_switch_cases(cppevents, opcode_switch, "handler", "event", namespace)
 
     return _event_dispatcher_class(typedef,
                                    ctors,
                                    switch,
                                    members,
-                                   len(cppevents) > 0)
+                                   len(cppevents) + len(ge_events) > 0)
 
 def event_switch_cases(cppevents, arg_switch, arg_handler, arg_event, ns):
     cases = ""
@@ -191,8 +239,10 @@ def event_switch_cases(cppevents, arg_switch, arg_handler, arg_event, ns):
 ########## EVENT ##########
 
 class CppEvent(object):
-    def __init__(self, opcode, opcode_name, c_name, namespace, name, fields):
+    def __init__(self, opcode, opcode_name, c_name, namespace, name, fields,
+                 is_ge_event=False):
         self.opcode = opcode
+        self.is_ge_event = is_ge_event
         self.opcode_name = opcode_name
         self.c_name = c_name
         self.namespace = namespace
@@ -241,6 +291,10 @@ class CppEvent(object):
 
                 member_accessors.append(_field_accessor_template(c_type, method_name, member))
 
+        window_id = _window_id(self.fields)
+        if window_id != None:
+            member_accessors.append(window_id)
+
         ns = get_namespace(self.namespace)
 
         extension = "xpp::%s::extension" % ns
@@ -248,7 +302,7 @@ class CppEvent(object):
         ctor = \
             [ "template<typename C>"
             , "%s(C && c," % self.get_name()
-            , (" " * len(self.get_name())) + " const std::shared_ptr<xcb_generic_event_t> & event)"
+            , (" " * len(self.get_name())) + " const xpp::generic::event_ptr & event)"
             , "  : base(event)"
             , "  , m_c(std::forward<C>(c))"
             , "{}"
@@ -299,7 +353,7 @@ class CppEvent(object):
                 [ "template<typename C>"
                 , "%s(C && c," % self.get_name()
                 , (" " * len(self.get_name())) + " uint8_t first_event,"
-                , (" " * len(self.get_name())) + " const std::shared_ptr<xcb_generic_event_t> & event)"
+                , (" " * len(self.get_name())) + " const xpp::generic::event_ptr & event)"
                 , "  : base(event)"
                 , "  , m_c(std::forward<C>(c))"
                 , "  , m_first_event(first_event)"
@@ -308,6 +362,31 @@ class CppEvent(object):
 
             m_first_event = "    const uint8_t m_first_event;\n"
 
+        if self.namespace.is_ext and self.is_ge_event:
+            # the response type of XGE events is always XCB_GE_GENERIC,
+            # event_type() is the opcode within the extension
+            opcode_accessor = \
+                [ "static uint8_t opcode(void)"
+                , "{"
+                , "  return XCB_GE_GENERIC;"
+                , "}"
+                , ""
+                , "static uint8_t opcode(uint8_t)"
+                , "{"
+                , "  return opcode();"
+                , "}"
+                , ""
+                , "static uint8_t opcode(const xpp::%s::extension &)" % ns
+                , "{"
+                , "  return opcode();"
+                , "}"
+                , ""
+                , "static uint16_t event_type(void)"
+                , "{"
+                , "  return %s;" % self.opcode_name
+                , "}"
+                ]
+
         if len(opcode_accessor) > 0:
             opcode_accessor = "\n".join(map(lambda s: "    " + s, opcode_accessor)) + "\n"
         else:
@@ -353,8 +432,6 @@ class %s
 
 %s\
 
-    virtual ~%s(void) {}
-
 %s\
 %s\
 %s\
@@ -370,7 +447,6 @@ class %s
        typedef,
        self.c_name, # typedef xpp::generic::event<%s>::base;
        ctor,
-       self.get_name(), # virtual ~%s(void) {}
        opcode_accessor,
        description,
        first_event,
@@ -1,4 +1,4 @@
-from utils import _n, _ext, _n_item, get_namespace
+from utils import _n, _ext, _n_item, get_namespace, get_request_info
 from resource_classes import _resource_classes
 
 _templates = {}
@@ -32,6 +32,13 @@ class %s
       : base(std::forward<C>(c), std::forward<Parameter>(parameter) ...)
     {}
 
+    static
+    xpp::generic::request_info
+    request_info(void)
+    {
+      return %s;
+    }
+
 %s\
 %s\
 }; // class %s
@@ -55,7 +62,7 @@ using %s = detail::%s<
 } // namespace reply
 '''
 
-def _reply_class(name, c_name, ns, cookie, accessors):
+def _reply_class(name, c_name, ns, request_info, cookie, accessors):
     return _templates['reply_class'] % \
             ( name
             , name # base class
@@ -63,6 +70,7 @@ def _reply_class(name, c_name, ns, cookie, accessors):
             , name # typedef
             , c_name # %s_reply
             , name # c'tor
+            , request_info
             , cookie.make_static_getter()
             , accessors
             , name # // class %s
@@ -134,5 +142,5 @@ class CppReply(object):
         result = ""
         result += _reply_class(
             self.request_name, self.c_name, get_namespace(self.namespace),
-            self.cookie, "\n".join(accessors))
+            get_request_info(self.namespace, self.c_name), self.cookie, "\n".join(accessors))
         return result
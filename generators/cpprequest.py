@@ -1,7 +1,7 @@
 # vim: set ts=4 sws=4 sw=4:
 
 # from utils import *
-from utils import _n, _ext, _n_item, get_namespace
+from utils import _n, _ext, _n_item, get_namespace, get_request_info, get_request_size
 from parameter import *
 from resource_classes import _resource_classes
 from cppreply import CppReply
@@ -15,28 +15,33 @@ template<typename Connection, typename ... Parameter>
 void
 %s_checked(Connection && c, Parameter && ... parameter)
 {
+  const xpp::generic::request_info request =
+    %s;
+  const xcb_void_cookie_t cookie =
+    %s_checked(c, std::forward<Parameter>(parameter) ...);
+  xpp::generic::sent(c, request);
   xpp::generic::check<Connection, xpp::%s::error::dispatcher>(
-      std::forward<Connection>(c),
-      %s_checked(
-          std::forward<Connection>(c),
-          std::forward<Parameter>(parameter) ...));
+      std::forward<Connection>(c), cookie, request);
 }
 
-template<typename ... Parameter>
+template<typename Connection, typename ... Parameter>
 void
-%s(Parameter && ... parameter)
+%s(Connection && c, Parameter && ... parameter)
 {
-  %s(std::forward<Parameter>(parameter) ...);
+  %s(c, std::forward<Parameter>(parameter) ...);
+  xpp::generic::sent(c, %s);
 }
 '''
 
-def _void_request_function(ns, name, c_name):
+def _void_request_function(ns, name, c_name, request_info):
     return _templates['void_request_function'] % \
             ( name
-            , ns
+            , request_info
             , c_name
+            , ns
             , name
             , c_name
+            , request_info
             )
 
 _templates['reply_request_function'] = \
@@ -178,7 +183,13 @@ class CppRequest(object):
             if len(void_functions) > 0:
                 return void_functions
             else:
-                return _void_request_function(get_namespace(self.namespace), self.request_name, self.c_name)
+                # the arguments are only known as the parameter pack
+                parameter = self.parameter_list.parameter
+                calls = [Parameter(None, c_name="std::get<%d>(std::tie(parameter ...))" % i)
+                         for i in range(len(parameter))]
+                size = get_request_size(self.c_name, parameter, calls)
+                return _void_request_function(get_namespace(self.namespace), self.request_name, self.c_name,
+                                              get_request_info(self.namespace, self.c_name, size))
 
         else:
             cppreply = CppReply(self.namespace, self.request.name, cppcookie, self.reply, self.accessors, self.parameter_list)
@@ -4,9 +4,76 @@ from utils import \
         _n_item, \
         _ext
 
+_templates = {}
+
+_templates['version'] = \
+'''\
+
+    // Sends QueryVersion with the version of these bindings. The reply is
+    // read by server_version().
+    void
+    negotiate_version(void)
+    {
+      m_version = %s(m_c%s);
+    }
+
+    // {0, 0} if negotiate_version() was not called or failed
+    std::pair<uint32_t, uint32_t>
+    server_version(void)
+    {
+      if (m_version.sequence != 0) {
+        xpp::generic::blocking_call call("server_version", id()->name);
+        xcb_generic_error_t * error = nullptr;
+        %s_reply_t * reply = %s_reply(m_c, m_version, &error);
+        m_version.sequence = 0;
+        if (reply) {
+          m_server_version = { reply->major_version, reply->minor_version };
+        }
+        std::free(reply);
+        std::free(error);
+      }
+      return m_server_version;
+    }
+
+  protected:
+    %s_cookie_t m_version = { 0 };
+    std::pair<uint32_t, uint32_t> m_server_version = { 0, 0 };
+'''
+
+# QueryVersion with either no parameters or the client version, and the
+# server version in the reply
+def _negotiates_version(request):
+    if request is None or request.reply is None:
+        return False
+    params = [f for f in request.request.fields if f.visible]
+    reply = [f.field_name for f in request.reply.fields]
+    return len(params) in (0, 2) \
+       and 'major_version' in reply and 'minor_version' in reply
+
 class ExtensionClass(object):
-    def __init__(self, namespace):
+    # query_version: the CppRequest of QueryVersion, if any
+    def __init__(self, namespace, query_version=None):
         self.namespace = namespace
+        self.query_version = query_version
+
+    def make_version(self):
+        request = self.query_version
+        if not self.namespace.is_ext or not _negotiates_version(request):
+            return ""
+
+        params = [f for f in request.request.fields if f.visible]
+        version = ""
+        if len(params) == 2:
+            prefix = "XCB_%s" % self.namespace.ext_name.upper()
+            version = ", %s_MAJOR_VERSION, %s_MINOR_VERSION" % (prefix, prefix)
+
+        return _templates['version'] % \
+                ( request.c_name
+                , version
+                , request.c_name
+                , request.c_name
+                , request.c_name
+                )
 
     def make_class(self):
         # if not self.namespace.is_ext:
@@ -37,9 +104,11 @@ class extension%s{
     template<typename Connection>
     using event_dispatcher = xpp::%s::event::dispatcher<Connection>;
     using error_dispatcher = xpp::%s::error::dispatcher;
+%s\
 };\
 ''' % (base,
        ctor,
        ns, # typedef xpp::interface::%s interface;
        ns, # typedef xpp::event::dispatcher::%s dispatcher;
-       ns) # typedef xpp::error::dispatcher::%s dispatcher;
+       ns, # typedef xpp::error::dispatcher::%s dispatcher;
+       self.make_version())
@@ -58,12 +58,9 @@ class %s
     }
 
   public:
-    virtual ~%s(void) {}
-
 %s
 }; // class %s
 """ % (name,   # class %s
        c_name, # %s resource(void) { ... }
-       name, # virtual ~%s(void)
        methods,
        name) # }; // class %s
@@ -13,6 +13,73 @@ def get_namespace(namespace):
     else:
         return "x"
 
+# xpp::generic::request_info for the request c_name, e.g. xcb_get_geometry
+# size defaults to the fixed part, see get_request_size()
+def get_request_info(namespace, c_name, size=None):
+    extension = ("&xcb_%s_id" % get_namespace(namespace)) \
+                if namespace.is_ext else "nullptr"
+    if size is None:
+        size = "sizeof(%s_request_t)" % c_name
+    return 'xpp::generic::request_info { "%s", %s, %s, %s }' \
+            % (c_name, extension, c_name.upper(), size)
+
+# C++ expression for a list length, names maps field names to the arguments
+# of the xcb request function. None for anything but arithmetic on fields and
+# values, e.g. sumof.
+def _length_expr(expr, names):
+    if expr.op is None:
+        if expr.lenfield_name is not None:
+            name = names.get(expr.lenfield_name)
+            if name is None:
+                return None
+            return ("xcb_popcount(%s)" % name) if expr.bitfield else name
+        if expr.nmemb is not None:
+            return str(expr.nmemb)
+        return None
+
+    if expr.op == '~' or expr.op == 'popcount':
+        rhs = _length_expr(expr.rhs, names)
+        if rhs is None:
+            return None
+        return ("(~%s)" % rhs) if expr.op == '~' else ("xcb_popcount(%s)" % rhs)
+
+    if expr.op in ('+', '-', '*', '/', '&', '<<'):
+        lhs = _length_expr(expr.lhs, names)
+        rhs = _length_expr(expr.rhs, names)
+        if lhs is None or rhs is None:
+            return None
+        return "(%s %s %s)" % (lhs, expr.op, rhs)
+
+    return None
+
+# The size of the request c_name on the wire, as a C++ expression of the
+# arguments passed to the xcb request function. calls are those arguments,
+# in the order of parameters. Lists without a plain length expression, e.g.
+# serialized switches, are not included.
+def get_request_size(c_name, parameters, calls):
+    names = {}
+    for param, call in zip(parameters, calls):
+        if param.field is not None:
+            names[param.field.field_name] = call.call()
+
+    size = "sizeof(%s_request_t)" % c_name
+    for param in parameters:
+        field = param.field
+        if (field is None or not field.type.is_list
+                or field.type.fixed_size()
+                or field.type.need_serialize
+                or not field.type.member.fixed_size()):
+            continue
+
+        length = _length_expr(field.type.expr, names)
+        if length is None:
+            continue
+
+        member = "1" if param.c_type == "void" else "sizeof(%s)" % param.c_type
+        size += "\n      + xpp::generic::padded(std::size_t(%s) * %s)" \
+                % (length, member)
+    return size
+
 def get_ext_name(str):
     return _ext(str)
 
@@ -19,6 +19,12 @@ class atom
     using base::operator=;
 };
 
+// Non-owning handle, copying it does not allocate
+template<typename Connection, template<typename, typename> class ... Interfaces>
+using borrowed_atom =
+  xpp::generic::borrowed_resource<Connection, xcb_atom_t,
+                                  xpp::x::atom, Interfaces ...>;
+
 namespace generic {
 
 template<typename Connection, template<typename, typename> class ... Interfaces>
@@ -0,0 +1,99 @@
+#ifndef XPP_ATOM_CACHE_HPP
+#define XPP_ATOM_CACHE_HPP
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "proto/x.hpp"
+
+namespace xpp {
+
+// Atoms by name and names by atom. Atoms are the same for all connections to
+// a server, hence one cache can be used with many connections. Batches are
+// interned with a single round trip.
+class atom_cache
+{
+  public:
+    template<typename Connection>
+    xcb_atom_t
+    intern(Connection && c, const std::string & name, bool only_if_exists = false)
+    {
+      return intern(std::forward<Connection>(c),
+                    std::vector<std::string> { name }, only_if_exists).front();
+    }
+
+    // XCB_ATOM_NONE for names which do not exist if only_if_exists is true
+    template<typename Connection>
+    std::vector<xcb_atom_t>
+    intern(Connection && c, const std::vector<std::string> & names,
+           bool only_if_exists = false)
+    {
+      std::vector<xcb_atom_t> atoms(names.size(), XCB_ATOM_NONE);
+      std::vector<std::size_t> missing;
+      {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        for (std::size_t i = 0; i < names.size(); ++i) {
+          auto item = m_atoms.find(names[i]);
+          if (item == m_atoms.end()) {
+            missing.push_back(i);
+          } else {
+            atoms[i] = item->second;
+          }
+        }
+      }
+
+      // all requests are sent before the first reply is read
+      std::vector<decltype(xpp::x::intern_atom(c, only_if_exists,
+                                               std::string()))> replies;
+      replies.reserve(missing.size());
+      for (auto i : missing) {
+        replies.push_back(xpp::x::intern_atom(c, only_if_exists, names[i]));
+      }
+
+      for (std::size_t n = 0; n < missing.size(); ++n) {
+        const xcb_atom_t atom = replies[n]->atom;
+        atoms[missing[n]] = atom;
+        // a missing atom may be created later
+        if (atom != XCB_ATOM_NONE) {
+          std::lock_guard<std::mutex> guard(m_mutex);
+          m_atoms.emplace(names[missing[n]], atom);
+          m_names.emplace(atom, names[missing[n]]);
+        }
+      }
+      return atoms;
+    }
+
+    template<typename Connection>
+    std::string
+    name(Connection && c, xcb_atom_t atom)
+    {
+      {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto item = m_names.find(atom);
+        if (item != m_names.end()) {
+          return item->second;
+        }
+      }
+
+      auto reply = xpp::x::get_atom_name(std::forward<Connection>(c), atom);
+      const xcb_get_atom_name_reply_t * r = reply.get().get();
+      std::string name(xcb_get_atom_name_name(r),
+                       xcb_get_atom_name_name_length(r));
+
+      std::lock_guard<std::mutex> guard(m_mutex);
+      m_names.emplace(atom, name);
+      m_atoms.emplace(name, atom);
+      return name;
+    }
+
+  protected:
+    std::mutex m_mutex;
+    std::unordered_map<std::string, xcb_atom_t> m_atoms;
+    std::unordered_map<xcb_atom_t, std::string> m_names;
+}; // class atom_cache
+
+} // namespace xpp
+
+#endif // XPP_ATOM_CACHE_HPP
@@ -0,0 +1,245 @@
+#ifndef XPP_COLOR_CACHE_HPP
+#define XPP_COLOR_CACHE_HPP
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#include "proto/x.hpp"
+#include "setup_index.hpp"
+
+namespace xpp {
+
+// Pixel values for a colormap. For TrueColor visuals pixels are computed from
+// the channel masks like the server does for AllocColor, without a request.
+// Otherwise colors are allocated with one round trip for a whole batch, also
+// for DirectColor, whose pixels depend on what the colormap cells hold. Named
+// colors are looked up once. Allocated colors are kept until the colormap is
+// freed.
+template<typename Connection>
+class color_cache
+{
+  public:
+    template<typename C>
+    color_cache(C && c, xcb_colormap_t colormap, xcb_visualid_t visual)
+      : m_c(std::forward<C>(c))
+      , m_colormap(colormap)
+    {
+      init(m_c, visual, 0);
+    }
+
+    color_cache(const color_cache &) = delete;
+    color_cache & operator=(const color_cache &) = delete;
+
+    // Pixels are computed locally
+    bool
+    local(void) const
+    {
+      return m_local;
+    }
+
+    uint32_t
+    pixel(uint16_t red, uint16_t green, uint16_t blue)
+    {
+      return pixels(std::vector<xcb_rgb_t> { { red, green, blue, 0 } }).front();
+    }
+
+    std::vector<uint32_t>
+    pixels(const std::vector<xcb_rgb_t> & colors)
+    {
+      std::vector<uint32_t> result(colors.size());
+      if (m_local) {
+        for (std::size_t i = 0; i < colors.size(); ++i) {
+          result[i] = compute(colors[i]);
+        }
+        return result;
+      }
+
+      // requested colors and the result slots which wait for them
+      std::vector<std::size_t> requested;
+      std::vector<std::size_t> slots(colors.size(), -1);
+      {
+        std::unordered_map<uint64_t, std::size_t> pending;
+        std::lock_guard<std::mutex> guard(m_mutex);
+        for (std::size_t i = 0; i < colors.size(); ++i) {
+          auto item = m_colors.find(key(colors[i]));
+          if (item != m_colors.end()) {
+            result[i] = item->second;
+            continue;
+          }
+          auto request = pending.emplace(key(colors[i]), requested.size());
+          if (request.second) {
+            requested.push_back(i);
+          }
+          slots[i] = request.first->second;
+        }
+      }
+
+      // all requests are sent before the first reply is read
+      std::vector<decltype(xpp::x::alloc_color(m_c, m_colormap,
+                                               uint16_t(), uint16_t(),
+                                               uint16_t()))> replies;
+      replies.reserve(requested.size());
+      for (auto i : requested) {
+        replies.push_back(xpp::x::alloc_color(m_c, m_colormap, colors[i].red,
+                                              colors[i].green, colors[i].blue));
+      }
+
+      // concurrent misses may allocate a color twice, which is harmless
+      std::vector<uint32_t> pixels(requested.size());
+      for (std::size_t n = 0; n < requested.size(); ++n) {
+        pixels[n] = replies[n]->pixel;
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_colors.emplace(key(colors[requested[n]]), pixels[n]);
+      }
+      for (std::size_t i = 0; i < colors.size(); ++i) {
+        if (slots[i] != std::size_t(-1)) {
+          result[i] = pixels[slots[i]];
+        }
+      }
+      return result;
+    }
+
+    uint32_t
+    named(const std::string & name)
+    {
+      return named(std::vector<std::string> { name }).front();
+    }
+
+    std::vector<uint32_t>
+    named(const std::vector<std::string> & names)
+    {
+      std::vector<uint32_t> result(names.size());
+      std::vector<std::size_t> requested;
+      std::vector<std::size_t> slots(names.size(), -1);
+      {
+        std::unordered_map<std::string, std::size_t> pending;
+        std::lock_guard<std::mutex> guard(m_mutex);
+        for (std::size_t i = 0; i < names.size(); ++i) {
+          auto item = m_names.find(names[i]);
+          if (item != m_names.end()) {
+            result[i] = item->second;
+            continue;
+          }
+          auto request = pending.emplace(names[i], requested.size());
+          if (request.second) {
+            requested.push_back(i);
+          }
+          slots[i] = request.first->second;
+        }
+      }
+
+      std::vector<decltype(xpp::x::alloc_named_color(m_c, m_colormap,
+                                                     std::string()))> replies;
+      replies.reserve(requested.size());
+      for (auto i : requested) {
+        replies.push_back(xpp::x::alloc_named_color(m_c, m_colormap, names[i]));
+      }
+
+      std::vector<uint32_t> pixels(requested.size());
+      for (std::size_t n = 0; n < requested.size(); ++n) {
+        pixels[n] = replies[n]->pixel;
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_names.emplace(names[requested[n]], pixels[n]);
+      }
+      for (std::size_t i = 0; i < names.size(); ++i) {
+        if (slots[i] != std::size_t(-1)) {
+          result[i] = pixels[slots[i]];
+        }
+      }
+      return result;
+    }
+
+  protected:
+    struct channel {
+      uint32_t m_shift = 0;
+      // largest value of the channel
+      uint32_t m_max = 0;
+
+      channel(void) = default;
+
+      explicit
+      channel(uint32_t mask)
+      {
+        if (mask != 0) {
+          m_shift = __builtin_ctz(mask);
+          m_max = mask >> m_shift;
+        }
+      }
+
+      uint32_t
+      operator()(uint16_t value) const
+      {
+        return uint32_t((uint64_t(value) * m_max + 0x8000) >> 16) << m_shift;
+      }
+    };
+
+    Connection m_c;
+    xcb_colormap_t m_colormap;
+    bool m_local = false;
+    channel m_red;
+    channel m_green;
+    channel m_blue;
+    uint32_t m_alpha = 0;
+
+    std::mutex m_mutex;
+    std::unordered_map<uint64_t, uint32_t> m_colors;
+    std::unordered_map<std::string, uint32_t> m_names;
+
+    // The setup index of xpp::core
+    template<typename C>
+    auto
+    init(const C & c, xcb_visualid_t visual, int)
+      -> decltype(c.setup(), void())
+    {
+      init(c.setup().visual(visual));
+    }
+
+    // e.g. xcb_connection_t *
+    template<typename C>
+    void
+    init(const C & c, xcb_visualid_t visual, long)
+    {
+      init(xpp::setup_index(xcb_get_setup(c)).visual(visual));
+    }
+
+    void
+    init(const xpp::setup_index::visual_info * info)
+    {
+      if (! info) {
+        return;
+      }
+
+      const xcb_visualtype_t & visual = *info->m_visual;
+      // DirectColor maps each channel through writable cells
+      m_local = visual._class == XCB_VISUAL_CLASS_TRUE_COLOR;
+      m_red = channel(visual.red_mask);
+      m_green = channel(visual.green_mask);
+      m_blue = channel(visual.blue_mask);
+      // the server sets the remaining bits of 32 bit visuals
+      if (info->m_depth == 32) {
+        m_alpha = ~(visual.red_mask | visual.green_mask | visual.blue_mask);
+      }
+    }
+
+    uint32_t
+    compute(const xcb_rgb_t & color) const
+    {
+      return m_red(color.red) | m_green(color.green) | m_blue(color.blue)
+           | m_alpha;
+    }
+
+    static
+    uint64_t
+    key(const xcb_rgb_t & color)
+    {
+      return uint64_t(color.red) << 32 | uint32_t(color.green) << 16
+           | color.blue;
+    }
+}; // class color_cache
+
+} // namespace xpp
+
+#endif // XPP_COLOR_CACHE_HPP
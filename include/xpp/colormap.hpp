@@ -37,10 +37,7 @@ class colormap
           {
             xpp::x::create_colormap(c, alloc, colormap, window, visual);
           },
-          [&](const Connection & c, const xcb_colormap_t & colormap)
-          {
-            xpp::x::free_colormap(c, colormap);
-          });
+          xpp::generic::free_function { &xcb_free_colormap, &xcb_free_colormap_checked });
     }
 
     template<typename C>
@@ -55,13 +52,16 @@ class colormap
           {
             xpp::x::create_colormap_checked(c, alloc, colormap, window, visual);
           },
-          [&](const Connection & c, const xcb_colormap_t & colormap)
-          {
-            xpp::x::free_colormap_checked(c, colormap);
-          });
+          xpp::generic::free_function { &xcb_free_colormap, &xcb_free_colormap_checked });
     }
 };
 
+// Non-owning handle, copying it does not allocate
+template<typename Connection, template<typename, typename> class ... Interfaces>
+using borrowed_colormap =
+  xpp::generic::borrowed_resource<Connection, xcb_colormap_t,
+                                  xpp::x::colormap, Interfaces ...>;
+
 namespace generic {
 
 template<typename Connection, template<typename, typename> class ... Interfaces>
@@ -1,6 +1,9 @@
 #ifndef XPP_CONNECTION_HPP
 #define XPP_CONNECTION_HPP
 
+#include <initializer_list>
+#include <xcb/bigreq.h>
+
 #include "core.hpp"
 #include "generic/factory.hpp"
 
@@ -8,8 +11,24 @@
 
 namespace xpp {
 
+// Constructs a connection whose extensions are only queried when they are
+// used first, e.g. xpp::connection<..> c(xpp::lazy_extensions, "");
+struct lazy_extensions_t {};
+static constexpr lazy_extensions_t lazy_extensions {};
+
+// Constructs a connection which sends QueryVersion for every present extension
+// which has one right after setup, e.g.
+// xpp::connection<..> c(xpp::negotiate_versions, "");
+struct negotiate_versions_t {};
+static constexpr negotiate_versions_t negotiate_versions {};
+
 namespace detail {
 
+struct construct {
+  bool m_lazy;
+  bool m_negotiate;
+};
+
 template<typename Connection, typename ... Extensions>
 class interfaces
   : public xpp::x::extension::interface<interfaces<Connection, Extensions ...>, Connection>
@@ -23,6 +42,47 @@ class interfaces
     }
 }; // class interfaces
 
+// Queued with the QueryExtension requests of the extensions, so that
+// prefetching the maximum request length does not need another round trip
+class prefetch_big_requests
+{
+  public:
+    explicit
+    prefetch_big_requests(xcb_connection_t * c)
+    {
+      xcb_prefetch_extension_data(c, &xcb_big_requests_id);
+    }
+}; // class prefetch_big_requests
+
+// negotiate_version() is generated for extensions with a QueryVersion request
+template<typename Extension>
+auto
+negotiate_version(Extension & extension, int)
+  -> decltype(extension.negotiate_version(), void())
+{
+  const xcb_query_extension_reply_t * data = extension;
+  if (data && data->present) {
+    extension.negotiate_version();
+  }
+}
+
+template<typename Extension>
+void
+negotiate_version(Extension &, long)
+{}
+
+// 0 until a lazy extension is resolved
+template<typename Extension>
+uint8_t
+first_error(Extension & extension, bool lazy)
+{
+  const xcb_query_extension_reply_t * data = nullptr;
+  if (! lazy) {
+    data = extension.get();
+  }
+  return data ? data->first_error : 0;
+}
+
 } // namespace detail
 
 template<typename ... Extensions>
@@ -33,6 +93,7 @@ class connection
   // private interfaces: extensions and error_dispatcher
   , private xpp::x::extension
   , private xpp::x::extension::error_dispatcher
+  , private detail::prefetch_big_requests
   , private Extensions ...
   , private Extensions::error_dispatcher ...
 {
@@ -40,16 +101,85 @@ class connection
     typedef connection<Extensions ...> self;
 
 
-  public:
+    // QueryExtension is sent for all extensions, lazy extensions read the
+    // reply when they are used first. QueryVersion only on request.
     template<typename ... Parameters>
-    explicit
-    connection(Parameters && ... parameters)
+    connection(detail::construct mode, Parameters && ... parameters)
       : xpp::core::core(std::forward<Parameters>(parameters) ...)
       , detail::interfaces<connection<Extensions ...>, Extensions ...>(*this)
+      , detail::prefetch_big_requests(*static_cast<xpp::core &>(*this))
       , Extensions(static_cast<xcb_connection_t *>(*this)) ...
-      , Extensions::error_dispatcher(static_cast<Extensions &>(*this).get()) ...
+      , Extensions::error_dispatcher(
+          detail::first_error(static_cast<Extensions &>(*this), mode.m_lazy)) ...
+      , m_lazy(mode.m_lazy)
+      , m_negotiated(mode.m_negotiate && ! mode.m_lazy)
     {
       m_root_window = screen_of_display(default_screen())->root;
+      if (m_lazy) {
+        return;
+      }
+      // All QueryExtension replies were read with the first get() above,
+      // from here on nothing waits for a reply
+      prefetch_maximum_request_length();
+      if (m_negotiated) {
+        (void)std::initializer_list<int> {
+          (detail::negotiate_version(static_cast<Extensions &>(*this), 0), 0) ...
+        };
+      }
+    }
+
+  public:
+    template<typename ... Parameters>
+    explicit
+    connection(Parameters && ... parameters)
+      : connection(detail::construct { false, false },
+                   std::forward<Parameters>(parameters) ...)
+    {}
+
+    template<typename ... Parameters>
+    explicit
+    connection(xpp::lazy_extensions_t, Parameters && ... parameters)
+      : connection(detail::construct { true, false },
+                   std::forward<Parameters>(parameters) ...)
+    {}
+
+    template<typename ... Parameters>
+    explicit
+    connection(xpp::negotiate_versions_t, Parameters && ... parameters)
+      : connection(detail::construct { false, true },
+                   std::forward<Parameters>(parameters) ...)
+    {}
+
+    // xpp::shared_setup comes first, e.g. for xpp::connection_pool
+    template<typename ... Parameters>
+    explicit
+    connection(xpp::shared_setup setup, xpp::lazy_extensions_t,
+               Parameters && ... parameters)
+      : connection(detail::construct { true, false },
+                   setup, std::forward<Parameters>(parameters) ...)
+    {}
+
+    template<typename ... Parameters>
+    explicit
+    connection(xpp::shared_setup setup, xpp::negotiate_versions_t,
+               Parameters && ... parameters)
+      : connection(detail::construct { false, true },
+                   setup, std::forward<Parameters>(parameters) ...)
+    {}
+
+    // The server version of Extension, from the QueryVersion request which
+    // was sent when connecting with xpp::negotiate_versions, otherwise sent
+    // now. Extension must have a QueryVersion request.
+    template<typename Extension>
+    std::pair<uint32_t, uint32_t>
+    server_version(void)
+    {
+      auto & extension = static_cast<Extension &>(*this);
+      if (! m_negotiated
+          && extension.server_version() == std::pair<uint32_t, uint32_t>()) {
+        detail::negotiate_version(extension, 0);
+      }
+      return extension.server_version();
     }
 
     virtual
@@ -124,6 +254,9 @@ class connection
 
   private:
     xcb_window_t m_root_window;
+    bool m_lazy;
+    // QueryVersion was sent when connecting
+    bool m_negotiated;
 
     template<typename Extension, typename Next, typename ... Rest>
     void
@@ -137,17 +270,49 @@ class connection
     void
     check(const std::shared_ptr<xcb_generic_error_t> & error) const
     {
+      if (m_lazy) {
+        check(static_cast<const Extension &>(*this), error);
+        return;
+      }
       using error_dispatcher = typename Extension::error_dispatcher;
       auto & dispatcher = static_cast<const error_dispatcher &>(*this);
       dispatcher(error);
     }
+
+    void
+    check(const xpp::x::extension &,
+          const std::shared_ptr<xcb_generic_error_t> & error) const
+    {
+      using error_dispatcher = xpp::x::extension::error_dispatcher;
+      static_cast<const error_dispatcher &>(*this)(error);
+    }
+
+    // Requests of generated interfaces do not resolve the extension, hence
+    // it is resolved here. Its QueryExtension reply was sent before the
+    // request which caused the error, reading it does not block.
+    template<typename Extension>
+    void
+    check(const Extension & extension,
+          const std::shared_ptr<xcb_generic_error_t> & error) const
+    {
+      const xcb_query_extension_reply_t * data = extension;
+      if (data && data->present) {
+        typename Extension::error_dispatcher dispatcher(extension);
+        dispatcher(error);
+      }
+    }
 }; // class connection
 
+// Without extensions the maximum request length is not prefetched, it would
+// cost a round trip
 template<>
 template<typename ... Parameters>
-connection<>::connection(Parameters && ... parameters)
+connection<>::connection(detail::construct mode, Parameters && ... parameters)
   : xpp::core::core(std::forward<Parameters>(parameters) ...)
   , detail::interfaces<connection<>>(*this)
+  , detail::prefetch_big_requests(*static_cast<xpp::core &>(*this))
+  , m_lazy(mode.m_lazy)
+  , m_negotiated(false)
 {
   m_root_window = screen_of_display(static_cast<core &>(*this).default_screen())->root;
 }
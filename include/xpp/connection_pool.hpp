@@ -0,0 +1,241 @@
+#ifndef XPP_CONNECTION_POOL_HPP
+#define XPP_CONNECTION_POOL_HPP
+
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <vector>
+#include <cstdlib>
+#include <stdexcept>
+#include <type_traits>
+#include <condition_variable>
+
+#include "connection.hpp"
+#include "atom_cache.hpp"
+
+namespace xpp {
+
+// Several connections to the same display, so that threads do not contend
+// for the output lock of a single connection. The server orders requests only
+// within a connection, use sync() where requests on different connections
+// depend on each other, e.g. drawing to a pixmap created on another one.
+template<typename Connection = xpp::connection<>>
+class connection_pool
+{
+  public:
+    // Exclusive use of a connection until the lease is destroyed
+    class lease
+    {
+      public:
+        lease(lease && other)
+          : m_pool(other.m_pool), m_index(other.m_index)
+        {
+          other.m_pool = nullptr;
+        }
+
+        lease & operator=(lease &&) = delete;
+
+        ~lease(void)
+        {
+          if (m_pool) {
+            m_pool->give_back(m_index);
+          }
+        }
+
+        Connection &
+        operator*(void) const
+        {
+          return (*m_pool)[m_index];
+        }
+
+        Connection *
+        operator->(void) const
+        {
+          return &(*m_pool)[m_index];
+        }
+
+        std::size_t
+        index(void) const
+        {
+          return m_index;
+        }
+
+      private:
+        friend class connection_pool;
+
+        connection_pool * m_pool;
+        std::size_t m_index;
+
+        lease(connection_pool * pool, std::size_t index)
+          : m_pool(pool), m_index(index)
+        {}
+    }; // class lease
+
+    // Each connection is constructed with parameters. The first connects
+    // alone, its setup data is indexed once for all of them; the others
+    // connect in parallel and are given that index with xpp::shared_setup, if
+    // Connection can be constructed with it.
+    template<typename ... Parameters>
+    explicit
+    connection_pool(std::size_t size, const Parameters & ... parameters)
+    {
+      if (size == 0) {
+        throw std::invalid_argument("connection_pool: size must not be 0");
+      }
+
+      m_connections.emplace_back(new Connection(parameters ...));
+      m_setup = xpp::setup_index::copy(xcb_get_setup(*m_connections.front()));
+
+      std::vector<std::future<Connection *>> connecting;
+      for (std::size_t i = 1; i < size; ++i) {
+        connecting.push_back(std::async(std::launch::async, [&](void)
+            {
+              return connect(std::is_constructible<Connection,
+                               const xpp::shared_setup &,
+                               const Parameters & ...>(),
+                             parameters ...);
+            }));
+      }
+      // take all of them, so that none leaks if one throws
+      std::exception_ptr error;
+      for (auto & c : connecting) {
+        try {
+          m_connections.emplace_back(c.get());
+        } catch (...) {
+          error = std::current_exception();
+        }
+      }
+      if (error) {
+        std::rethrow_exception(error);
+      }
+
+      for (std::size_t i = size; i > 0; --i) {
+        m_idle.push_back(i - 1);
+      }
+    }
+
+    connection_pool(const connection_pool &) = delete;
+    connection_pool & operator=(const connection_pool &) = delete;
+
+    std::size_t
+    size(void) const
+    {
+      return m_connections.size();
+    }
+
+    Connection &
+    operator[](std::size_t index) const
+    {
+      return *m_connections[index];
+    }
+
+    // The connection of the calling thread. Threads are spread round robin,
+    // without locking. Connections may be shared with other threads.
+    Connection &
+    local(void) const
+    {
+      static std::atomic<std::size_t> threads { 0 };
+      thread_local std::size_t thread = threads.fetch_add(1, std::memory_order_relaxed);
+      return *m_connections[thread % m_connections.size()];
+    }
+
+    // Waits until a connection is not leased
+    lease
+    acquire(void)
+    {
+      std::unique_lock<std::mutex> guard(m_mutex);
+      m_released.wait(guard, [this](void) { return ! m_idle.empty(); });
+      const std::size_t index = m_idle.back();
+      m_idle.pop_back();
+      return lease(this, index);
+    }
+
+    // Shared by all connections, atoms are the same for all of them
+    xpp::atom_cache &
+    atoms(void)
+    {
+      return m_atoms;
+    }
+
+    // Shared by all connections, valid after they are gone
+    const xpp::setup_index &
+    setup(void) const
+    {
+      return *m_setup;
+    }
+
+    // Returns when the server processed all requests sent on c before.
+    // Requests which are sent afterwards on any connection of the pool are
+    // processed after them.
+    static
+    void
+    sync(const Connection & c)
+    {
+      c.flush();
+      xpp::generic::blocking_call call("sync");
+      std::free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), nullptr));
+    }
+
+    // sync() for all connections, with a single round trip
+    void
+    sync(void) const
+    {
+      std::vector<xcb_get_input_focus_cookie_t> cookies;
+      for (auto & c : m_connections) {
+        c->flush();
+        cookies.push_back(xcb_get_input_focus(*c));
+      }
+      xpp::generic::blocking_call call("sync");
+      for (std::size_t i = 0; i < cookies.size(); ++i) {
+        std::free(xcb_get_input_focus_reply(*m_connections[i], cookies[i],
+                                            nullptr));
+      }
+    }
+
+    void
+    flush(void) const
+    {
+      for (auto & c : m_connections) {
+        c->flush();
+      }
+    }
+
+  protected:
+    std::vector<std::unique_ptr<Connection>> m_connections;
+    xpp::atom_cache m_atoms;
+    // of a copy of the setup data of the first connection
+    std::shared_ptr<const xpp::setup_index> m_setup;
+
+    std::mutex m_mutex;
+    std::condition_variable m_released;
+    std::vector<std::size_t> m_idle;
+
+    template<typename ... Parameters>
+    Connection *
+    connect(std::true_type, const Parameters & ... parameters) const
+    {
+      return new Connection(xpp::shared_setup { m_setup }, parameters ...);
+    }
+
+    template<typename ... Parameters>
+    Connection *
+    connect(std::false_type, const Parameters & ... parameters) const
+    {
+      return new Connection(parameters ...);
+    }
+
+    void
+    give_back(std::size_t index)
+    {
+      {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_idle.push_back(index);
+      }
+      m_released.notify_one();
+    }
+}; // class connection_pool
+
+} // namespace xpp
+
+#endif // XPP_CONNECTION_POOL_HPP
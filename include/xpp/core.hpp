@@ -3,8 +3,19 @@
 
 #include <string>
 #include <memory>
+#include <vector>
+#include <stdexcept>
+#include <functional>
 #include <xcb/xcb.h>
 
+#include "generic/event.hpp"
+#include "generic/deferred.hpp"
+#include "generic/profiler.hpp"
+#include "generic/accounting.hpp"
+#include "generic/flush_policy.hpp"
+#include "event/statistics.hpp"
+#include "setup_index.hpp"
+
 namespace xpp {
 
 class connection_error
@@ -34,44 +45,144 @@ class connection_error
     std::string m_description;
 };
 
+// Throws connection_error if c is in an error state
+inline
+void
+check_connection(xcb_connection_t * c)
+{
+  switch (xcb_connection_has_error(c)) {
+    case XCB_CONN_ERROR:
+      throw(connection_error(
+            XCB_CONN_ERROR, "XCB_CONN_ERROR"));
+
+    case XCB_CONN_CLOSED_EXT_NOTSUPPORTED:
+      throw(connection_error(XCB_CONN_CLOSED_EXT_NOTSUPPORTED,
+                             "XCB_CONN_CLOSED_EXT_NOTSUPPORTED"));
+
+    case XCB_CONN_CLOSED_MEM_INSUFFICIENT:
+      throw(connection_error(XCB_CONN_CLOSED_MEM_INSUFFICIENT,
+                             "XCB_CONN_CLOSED_MEM_INSUFFICIENT"));
+
+    case XCB_CONN_CLOSED_REQ_LEN_EXCEED:
+      throw(connection_error(XCB_CONN_CLOSED_REQ_LEN_EXCEED,
+                             "XCB_CONN_CLOSED_REQ_LEN_EXCEED"));
+
+    case XCB_CONN_CLOSED_PARSE_ERR:
+      throw(connection_error(XCB_CONN_CLOSED_PARSE_ERR,
+                             "XCB_CONN_CLOSED_PARSE_ERR"));
+
+    case XCB_CONN_CLOSED_INVALID_SCREEN:
+      throw(connection_error(XCB_CONN_CLOSED_INVALID_SCREEN,
+                             "XCB_CONN_CLOSED_INVALID_SCREEN"));
+  };
+}
+
+// Constructs a core which uses index instead of indexing the setup data of
+// its own connection, e.g. xpp::core c(xpp::shared_setup { index }, "").
+// Connections to the same display have the same screens, visuals and formats.
+struct shared_setup {
+  std::shared_ptr<const xpp::setup_index> m_index;
+};
+
 class core
 {
   protected:
-    using shared_generic_event_ptr = std::shared_ptr<xcb_generic_event_t>;
+    using shared_generic_event_ptr = xpp::generic::event_ptr;
 
     int m_screen = 0;
     // reference counting for xcb_connection_t
     std::shared_ptr<xcb_connection_t> m_c;
+    // recycles the reference counts of events returned by this connection
+    std::shared_ptr<xpp::generic::event_pool> m_events =
+      xpp::generic::event_pool::create();
+    // sees every event and error read from this connection
+    std::function<void(const xcb_generic_event_t &)> m_observer;
+    std::shared_ptr<xpp::event::statistics> m_statistics;
+    // counts the requests sent through this connection
+    std::shared_ptr<xpp::generic::accounting> m_accounting;
+    // frees of resources created through this connection, sent on flush()
+    std::shared_ptr<xpp::generic::deferred_free> m_deferred =
+      std::make_shared<xpp::generic::deferred_free>();
+    // false: frees are sent right away
+    bool m_defer_frees = false;
+    // nullptr: xcb_generate_id
+    std::shared_ptr<xpp::generic::id_allocator> m_ids;
+    std::shared_ptr<const xpp::setup_index> m_setup;
+    // nullptr: flushed only by flush() and when xcb's buffer is full
+    std::shared_ptr<xpp::generic::flush_policy> m_flush_policy;
+
+    // xcb flushes before it blocks, deferred frees must be in its buffer
+    // by then
+    void
+    send_deferred_frees(void) const
+    {
+      if (m_defer_frees) {
+        m_deferred->flush(m_c.get(), m_ids.get());
+      }
+    }
+
+    shared_generic_event_ptr
+    make_event(xcb_generic_event_t * event) const
+    {
+      if (event && m_observer) {
+        m_observer(*event);
+      }
+      // errors are not stamped
+      if (event && event->response_type != 0 && m_statistics) {
+        m_statistics->read();
+        return m_events->make(event, xpp::event::statistics::now());
+      }
+      return m_events->make(event);
+    }
 
     shared_generic_event_ptr
     dispatch(const std::string & producer, xcb_generic_event_t * event) const
     {
       if (event) {
+        if (m_observer) {
+          m_observer(*event);
+        }
+
         if (event->response_type == 0) {
           throw std::shared_ptr<xcb_generic_error_t>(
               reinterpret_cast<xcb_generic_error_t *>(event));
         }
 
-        return shared_generic_event_ptr(event, std::free);
+        if (m_statistics) {
+          m_statistics->read();
+          return m_events->make(event, xpp::event::statistics::now());
+        }
+        return m_events->make(event);
       }
 
       check_connection();
       throw std::runtime_error(producer + " failed");
     }
 
+    // nullptr setup: indexes the setup data of this connection
+    template<typename ... ConnectionParameter>
+    core(const std::shared_ptr<const xpp::setup_index> & setup,
+         xcb_connection_t * (*Connect)(ConnectionParameter ...),
+         ConnectionParameter ... connection_parameter)
+      : m_c(std::shared_ptr<xcb_connection_t>(
+          Connect(connection_parameter ...),
+          [&](void *) { disconnect(); }))
+      , m_setup(setup ? setup : std::make_shared<xpp::setup_index>(
+                                  xcb_get_setup(m_c.get())))
+    {}
+
   public:
     explicit
     core(xcb_connection_t * c)
       : m_c(std::shared_ptr<xcb_connection_t>(c, [](...) {}))
+      , m_setup(std::make_shared<xpp::setup_index>(xcb_get_setup(c)))
     {}
 
     template<typename ... ConnectionParameter>
     explicit
     core(xcb_connection_t * (*Connect)(ConnectionParameter ...),
                ConnectionParameter ... connection_parameter)
-      : m_c(std::shared_ptr<xcb_connection_t>(
-          Connect(connection_parameter ...),
-          [&](void *) { disconnect(); }))
+      : core(nullptr, Connect, connection_parameter ...)
     {}
 
     // xcb_connect (const char *displayname, int *screenp)
@@ -94,9 +205,36 @@ class core
                    display.c_str(), auth, &m_screen)
     {}
 
+    // The constructors above, with the setup index of another connection
+    explicit
+    core(const xpp::shared_setup & setup, const std::string & displayname = "")
+      : core(setup.m_index, xcb_connect, displayname.c_str(), &m_screen)
+    {}
+
+    explicit
+    core(const xpp::shared_setup & setup, int fd, xcb_auth_info_t * auth_info)
+      : core(setup.m_index, xcb_connect_to_fd, fd, auth_info)
+    {}
+
+    explicit
+    core(const xpp::shared_setup & setup,
+         const std::string & display, xcb_auth_info_t * auth)
+      : core(setup.m_index, xcb_connect_to_display_with_auth_info,
+             display.c_str(), auth, &m_screen)
+    {}
+
     virtual
     ~core(void)
-    {}
+    {
+      // the last copy sends what is left, the server frees it on disconnect
+      // anyway, but a borrowed xcb_connection_t may outlive this core
+      if (m_deferred.use_count() == 1) {
+        m_deferred->flush(m_c.get(), m_ids.get());
+        if (m_flush_policy) {
+          m_flush_policy->flush(m_c.get());
+        }
+      }
+    }
 
     virtual
     xcb_connection_t *
@@ -111,6 +249,46 @@ class core
       return m_c.get();
     }
 
+    // Called for every event read from this connection, before it is
+    // dispatched. Not synchronized with reading events.
+    void
+    observe_events(const std::function<void(const xcb_generic_event_t &)> & f)
+    {
+      m_observer = f;
+    }
+
+    // Stamps events with the time they were read, for a registry which is
+    // instrumented with the same statistics
+    void
+    instrument(const std::shared_ptr<xpp::event::statistics> & statistics)
+    {
+      m_statistics = statistics;
+      if (statistics) {
+        m_events->on_release([statistics](uint64_t)
+                             {
+                               statistics->released();
+                             });
+      } else {
+        m_events->on_release(nullptr);
+      }
+    }
+
+    // Counts requests, replies and errors of this connection into
+    // accounting, which may be shared with other connections. nullptr stops
+    // counting. Not synchronized with sending requests.
+    void
+    account(const std::shared_ptr<xpp::generic::accounting> & accounting)
+    {
+      m_accounting = accounting;
+    }
+
+    // Called by generated requests, see xpp::generic::sent()
+    xpp::generic::accounting *
+    accounting(void) const
+    {
+      return m_accounting.get();
+    }
+
     virtual
     int
     default_screen(void) const
@@ -118,13 +296,87 @@ class core
       return m_screen;
     }
 
+    // Sends deferred frees first
     virtual
     int
     flush(void) const
     {
+      m_deferred->flush(m_c.get(), m_ids.get());
+      if (m_flush_policy) {
+        return m_flush_policy->flush(m_c.get());
+      }
       return xcb_flush(m_c.get());
     }
 
+    // Decides when requests sent through this connection are flushed, e.g.
+    // xpp::flush_scheduler. Not synchronized with sending requests. Throws
+    // std::invalid_argument if policy is bound to another connection.
+    void
+    schedule_flushes(const std::shared_ptr<xpp::generic::flush_policy> & policy)
+    {
+      if (policy && policy->connection()
+          && policy->connection() != m_c.get()) {
+        throw std::invalid_argument(
+            "schedule_flushes: policy of another connection");
+      }
+      m_flush_policy = policy;
+    }
+
+    // Called by generated requests, see xpp::generic::sent()
+    void
+    request_sent(const xpp::generic::request_info & request) const
+    {
+      if (m_flush_policy) {
+        m_flush_policy->sent(m_c.get(), request);
+      }
+    }
+
+    // Queues the frees of resources created with xpp::generic::free_function
+    // until flush(), flush_checked(), wait_for_event(), request_check() or
+    // the destruction of the last copy of this connection. Replies and raw
+    // xcb calls do not send them: call flush() before waiting on the server
+    // for the effect of a free, e.g. a DestroyNotify. Not synchronized with
+    // freeing resources.
+    void
+    defer_frees(bool defer = true)
+    {
+      m_defer_frees = defer;
+      if (! defer) {
+        m_deferred->flush(m_c.get(), m_ids.get());
+      }
+    }
+
+    // Called when the last reference on a resource created with
+    // xpp::generic::free_function is dropped
+    void
+    free_resource(const xpp::generic::free_function & f, uint32_t xid) const
+    {
+      if (m_defer_frees) {
+        m_deferred->push(f, xid);
+      } else {
+        f.m_unchecked(m_c.get(), xid);
+        if (m_ids) {
+          m_ids->release(xid);
+        }
+      }
+    }
+
+    // Frees not sent yet, see defer_frees()
+    xpp::generic::deferred_free &
+    deferred_frees(void) const
+    {
+      return *m_deferred;
+    }
+
+    // Sends deferred frees and verifies them with a single round trip, which
+    // also confirms the ids freed since the last call to the id allocator
+    std::vector<std::shared_ptr<xcb_generic_error_t>>
+    flush_checked(void) const
+    {
+      xpp::generic::blocking_call call("flush_checked");
+      return m_deferred->flush_checked(m_c.get(), m_ids.get());
+    }
+
     virtual
     uint32_t
     get_maximum_request_length(void) const
@@ -143,28 +395,34 @@ class core
     shared_generic_event_ptr
     wait_for_event(void) const
     {
-      return dispatch("wait_for_event", xcb_wait_for_event(m_c.get()));
+      xcb_generic_event_t * event = nullptr;
+      send_deferred_frees();
+      {
+        xpp::generic::blocking_call call("wait_for_event");
+        event = xcb_wait_for_event(m_c.get());
+      }
+      return dispatch("wait_for_event", event);
     }
 
     virtual
     shared_generic_event_ptr
     poll_for_event(void) const
     {
-      return shared_generic_event_ptr(xcb_poll_for_event(m_c.get()));
+      return make_event(xcb_poll_for_event(m_c.get()));
     }
 
     virtual
     shared_generic_event_ptr
     poll_for_queued_event(void) const
     {
-      return shared_generic_event_ptr(xcb_poll_for_queued_event(m_c.get()));
+      return make_event(xcb_poll_for_queued_event(m_c.get()));
     }
 
     virtual
     shared_generic_event_ptr
     poll_for_special_event(xcb_special_event_t * se) const
     {
-      return shared_generic_event_ptr(xcb_poll_for_special_event(m_c.get(), se));
+      return make_event(xcb_poll_for_special_event(m_c.get(), se));
     }
 
     // virtual
@@ -178,8 +436,13 @@ class core
     shared_generic_event_ptr
     wait_for_special_event(xcb_special_event_t * se) const
     {
-      return dispatch("wait_for_special_event",
-                      xcb_wait_for_special_event(m_c.get(), se));
+      xcb_generic_event_t * event = nullptr;
+      send_deferred_frees();
+      {
+        xpp::generic::blocking_call call("wait_for_special_event");
+        event = xcb_wait_for_special_event(m_c.get(), se);
+      }
+      return dispatch("wait_for_special_event", event);
     }
 
     // virtual
@@ -210,6 +473,8 @@ class core
     std::shared_ptr<xcb_generic_error_t>
     request_check(xcb_void_cookie_t cookie) const
     {
+      send_deferred_frees();
+      xpp::generic::blocking_call call("request_check");
       return std::shared_ptr<xcb_generic_error_t>(
           xcb_request_check(m_c.get(), cookie));
     }
@@ -244,6 +509,13 @@ class core
       return xcb_get_setup(m_c.get());
     }
 
+    // Screens, visuals and pixmap formats without walking the setup data
+    const xpp::setup_index &
+    setup(void) const
+    {
+      return *m_setup;
+    }
+
     virtual
     int
     get_file_descriptor(void) const
@@ -287,50 +559,27 @@ class core
     uint32_t
     generate_id(void) const
     {
-      return xcb_generate_id(m_c.get());
+      return m_ids ? m_ids->generate() : xcb_generate_id(m_c.get());
+    }
+
+    // Resource ids are taken from ids instead of xcb_generate_id. Afterwards
+    // xcb_generate_id must not be used on this connection anymore.
+    void
+    allocate_ids(const std::shared_ptr<xpp::generic::id_allocator> & ids)
+    {
+      m_ids = ids;
     }
 
     xcb_screen_t *
     screen_of_display(int screen)
     {
-      xcb_screen_iterator_t iter;
-
-      iter = xcb_setup_roots_iterator(xcb_get_setup(m_c.get()));
-      for (; iter.rem; --screen, xcb_screen_next(&iter))
-        if (screen == 0)
-          return iter.data;
-
-      return NULL;
+      return m_setup->screen(screen);
     }
 
     void
     check_connection(void) const
     {
-      switch (xcb_connection_has_error(m_c.get())) {
-        case XCB_CONN_ERROR:
-          throw(connection_error(
-                XCB_CONN_ERROR, "XCB_CONN_ERROR"));
-
-        case XCB_CONN_CLOSED_EXT_NOTSUPPORTED:
-          throw(connection_error(XCB_CONN_CLOSED_EXT_NOTSUPPORTED,
-                                 "XCB_CONN_CLOSED_EXT_NOTSUPPORTED"));
-
-        case XCB_CONN_CLOSED_MEM_INSUFFICIENT:
-          throw(connection_error(XCB_CONN_CLOSED_MEM_INSUFFICIENT,
-                                 "XCB_CONN_CLOSED_MEM_INSUFFICIENT"));
-
-        case XCB_CONN_CLOSED_REQ_LEN_EXCEED:
-          throw(connection_error(XCB_CONN_CLOSED_REQ_LEN_EXCEED,
-                                 "XCB_CONN_CLOSED_REQ_LEN_EXCEED"));
-
-        case XCB_CONN_CLOSED_PARSE_ERR:
-          throw(connection_error(XCB_CONN_CLOSED_PARSE_ERR,
-                                 "XCB_CONN_CLOSED_PARSE_ERR"));
-
-        case XCB_CONN_CLOSED_INVALID_SCREEN:
-          throw(connection_error(XCB_CONN_CLOSED_INVALID_SCREEN,
-                                 "XCB_CONN_CLOSED_INVALID_SCREEN"));
-      };
+      xpp::check_connection(m_c.get());
     }
 }; // class core
 
@@ -45,10 +45,7 @@ class cursor
                                        back_red, back_green, back_blue,
                                        x, y);
                },
-               [&](Connection & c, const xcb_cursor_t & cursor)
-               {
-                 xpp::x::free_cursor(c, cursor);
-               });
+               xpp::generic::free_function { &xcb_free_cursor, &xcb_free_cursor_checked });
     }
 
     template<typename C>
@@ -70,10 +67,7 @@ class cursor
                                                back_red, back_green, back_blue,
                                                x, y);
                },
-               [&](Connection & c, const xcb_cursor_t & cursor)
-               {
-                 xpp::x::free_cursor_checked(c, cursor);
-               });
+               xpp::generic::free_function { &xcb_free_cursor, &xcb_free_cursor_checked });
     }
 
     template<typename C>
@@ -95,10 +89,7 @@ class cursor
                                              fore_red, fore_green, fore_blue,
                                              back_red, back_green, back_blue);
                },
-               [](Connection & c, const xcb_cursor_t & cursor)
-               {
-                 xpp::x::free_cursor(c, cursor);
-               });
+               xpp::generic::free_function { &xcb_free_cursor, &xcb_free_cursor_checked });
     }
 
     template<typename C>
@@ -120,13 +111,16 @@ class cursor
                                                      fore_red, fore_green, fore_blue,
                                                      back_red, back_green, back_blue);
                },
-               [](Connection & c, const xcb_cursor_t & cursor)
-               {
-                 xpp::x::free_cursor_checked(c, cursor);
-               });
+               xpp::generic::free_function { &xcb_free_cursor, &xcb_free_cursor_checked });
     }
 };
 
+// Non-owning handle, copying it does not allocate
+template<typename Connection, template<typename, typename> class ... Interfaces>
+using borrowed_cursor =
+  xpp::generic::borrowed_resource<Connection, xcb_cursor_t,
+                                  xpp::x::cursor, Interfaces ...>;
+
 namespace generic {
 
 template<typename Connection, template<typename, typename> class ... Interfaces>
@@ -20,6 +20,12 @@ class drawable
     using base::operator=;
 };
 
+// Non-owning handle, copying it does not allocate
+template<typename Connection, template<typename, typename> class ... Interfaces>
+using borrowed_drawable =
+  xpp::generic::borrowed_resource<Connection, xcb_drawable_t,
+                                  xpp::x::drawable, Interfaces ...>;
+
 namespace generic {
 
 template<typename Connection, template<typename, typename> class ... Interfaces>
@@ -1,12 +1,16 @@
 #ifndef XPP_EVENT_HPP
 #define XPP_EVENT_HPP
 
+#include <array>
 #include <climits>
-#include <map>
+#include <memory>
 #include <vector>
-#include <unordered_map>
+#include <algorithm>
 
 #include "proto/x.hpp"
+#include "generic/epoch.hpp"
+#include "generic/xid_map.hpp"
+#include "event/statistics.hpp"
 
 #define MAX_PRIORITY UINT32_MAX
 
@@ -30,6 +34,38 @@ class sink : virtual public dispatcher
     virtual void handle(const Event &) = 0;
 };
 
+// Generated events which carry a window provide window_id()
+template<typename Event>
+auto
+window_id(const Event & e, int) -> decltype(e.window_id())
+{
+  return e.window_id();
+}
+
+template<typename Event>
+xcb_window_t
+window_id(const Event &, long)
+{
+  return XCB_NONE;
+}
+
+// XGE events share one response type, they are told apart by the major
+// opcode of their extension and their event_type()
+template<typename Event, typename Extension>
+auto
+ge_key(const Extension & extension, int)
+  -> decltype(Event::event_type(), uint32_t())
+{
+  return (1u << 24) | (extension->major_opcode << 16) | Event::event_type();
+}
+
+template<typename Event, typename Extension>
+uint32_t
+ge_key(const Extension &, long)
+{
+  return 0;
+}
+
 } // namespace detail
 
 template<typename Event, typename ... Events>
@@ -55,12 +91,63 @@ class registry
       , m_c(std::forward<C>(c))
     {}
 
+    ~registry(void)
+    {
+      for (auto & dispatchers : m_dispatchers) {
+        delete dispatchers.load();
+      }
+      m_ge_dispatchers.for_each(
+          [](uint32_t, const priority_slot & dispatchers)
+          {
+            delete dispatchers.load();
+          });
+    }
+
     bool
-    dispatch(const std::shared_ptr<xcb_generic_event_t> & event) const
+    dispatch(const xpp::generic::event_ptr & event) const
+    {
+      if (m_statistics) {
+        m_statistics->dispatch(event->response_type & ~0x80, event.time());
+      }
+      return dispatch<handler, xpp::x::extension, Extensions ...>(
+          handler(*this, event.time()), event);
+    }
+
+    // Measures latency, queue depth, event counts and time spent in each
+    // sink. Events are only timed if the connection is instrumented, too.
+    void
+    instrument(const std::shared_ptr<xpp::event::statistics> & statistics)
+    {
+      m_statistics = statistics;
+
+      // existing entries need their histograms
+      for (auto & dispatchers : m_dispatchers) {
+        instrument(dispatchers);
+      }
+      m_ge_dispatchers.for_each(
+          [this](uint32_t key, const priority_slot &)
+          {
+            instrument(*m_ge_dispatchers.find(key));
+          });
+      m_windows.for_each(
+          [this](uint32_t window, const shared_window_list &)
+          {
+            instrument(*m_windows.find(window));
+          });
+    }
+
+    // The window an event is delivered to, XCB_NONE if it has none
+    xcb_window_t
+    window(const xpp::generic::event_ptr & event) const
     {
-      return dispatch<xpp::x::extension, Extensions ...>(event);
+      xcb_window_t window = XCB_NONE;
+      dispatch<window_finder, xpp::x::extension, Extensions ...>(
+          window_finder { &window }, event);
+      return window;
     }
 
+    // May be called while another thread dispatches, but not concurrently
+    // with another attach() or detach()
     template<typename Event, typename ... Rest>
     void
     attach(priority p, sink<Event, Rest ...> * s)
@@ -75,11 +162,87 @@ class registry
       detach<sink<Event, Rest ...>, Event, Rest ...>(p, s);
     }
 
+    // Sinks attached to a window only receive events carrying this window.
+    // They are called after the sinks which are attached for all windows.
+    // Like sinks for XGE events, they must be attached and detached on the
+    // dispatching thread, or while no event is dispatched.
+    template<typename Event, typename ... Rest>
+    void
+    attach(xcb_window_t window, priority p, sink<Event, Rest ...> * s)
+    {
+      for (auto key : keys<Event, Rest ...>()) {
+        attach(window, p, s, key);
+      }
+    }
+
+    template<typename Event, typename ... Rest>
+    void
+    detach(xcb_window_t window, priority p, sink<Event, Rest ...> * s)
+    {
+      for (auto key : keys<Event, Rest ...>()) {
+        detach(window, p, s, key);
+      }
+    }
+
+    // Detaches all sinks of window, e.g. after it was destroyed
+    void
+    detach(xcb_window_t window)
+    {
+      m_windows.erase(window);
+    }
+
   private:
-    typedef std::multimap<priority, detail::dispatcher *> priority_map;
+    struct entry {
+      priority m_priority;
+      detail::dispatcher * m_dispatcher;
+      // nullptr unless instrumented
+      xpp::generic::histogram * m_histogram;
+    };
+
+    // sorted by priority; replaced as a whole on attach() and detach(), hence
+    // a dispatch in progress keeps iterating over its own snapshot. Replaced
+    // lists are retired to m_epoch, dispatches read them inside a guard.
+    typedef std::vector<entry> priority_list;
+
+    // movable for xid_map, moved only by the writer
+    struct priority_slot : std::atomic<const priority_list *> {
+      priority_slot(void)
+        : std::atomic<const priority_list *>(nullptr)
+      {}
+
+      priority_slot(priority_slot && other)
+        : std::atomic<const priority_list *>(
+            other.load(std::memory_order_relaxed))
+      {}
+
+      priority_slot &
+      operator=(priority_slot && other)
+      {
+        this->store(other.load(std::memory_order_relaxed));
+        return *this;
+      }
+    };
+
+    struct window_entry {
+      uint32_t m_key;
+      priority m_priority;
+      detail::dispatcher * m_dispatcher;
+      xpp::generic::histogram * m_histogram;
+    };
+
+    // sorted by key, then priority
+    typedef std::vector<window_entry> window_list;
+    typedef std::shared_ptr<const window_list> shared_window_list;
 
     Connection m_c;
-    std::unordered_map<uint8_t, priority_map> m_dispatchers;
+    // indexed by opcode
+    std::array<priority_slot, 256> m_dispatchers;
+    // XGE events, by detail::ge_key()
+    xpp::generic::xid_map<priority_slot> m_ge_dispatchers;
+    xpp::generic::xid_map<shared_window_list> m_windows;
+    std::shared_ptr<xpp::event::statistics> m_statistics;
+    // frees the priority lists which were replaced
+    xpp::generic::epoch m_epoch;
 
     template<typename Event>
     uint8_t opcode(const xpp::x::extension &) const
@@ -99,97 +262,286 @@ class registry
       return opcode<Event>(m_c.template extension<typename Event::extension>());
     }
 
+    // The opcode, or detail::ge_key() for XGE events
+    template<typename Event>
+    uint32_t key(void) const
+    {
+      const uint32_t ge_key = detail::ge_key<Event>(
+          m_c.template extension<typename Event::extension>(), 0);
+      return ge_key != 0 ? ge_key : opcode<Event>();
+    }
+
+    template<typename ... Events>
+    std::array<uint32_t, sizeof ... (Events)>
+    keys(void) const
+    {
+      return {{ key<Events>() ... }};
+    }
+
+    // Only valid while a guard of m_epoch is held
+    const priority_list *
+    dispatchers(uint32_t key) const
+    {
+      if (key < m_dispatchers.size()) {
+        return m_dispatchers[key].load(std::memory_order_seq_cst);
+      }
+      auto * list = m_ge_dispatchers.find(key);
+      return list ? list->load(std::memory_order_seq_cst) : nullptr;
+    }
+
     template<typename Event>
     void
-    handle(const Event & event) const
+    handle(const Event & event, uint64_t read_time) const
     {
+      const uint32_t k = key<Event>();
+      const xpp::generic::epoch::guard guard(m_epoch);
+      const priority_list * dispatchers = this->dispatchers(k);
+      shared_window_list window_dispatchers;
+
+      if (! m_windows.empty()) {
+        auto * list = m_windows.find(detail::window_id(event, 0));
+        if (list) {
+          window_dispatchers = *list;
+        }
+      }
+
+      if (m_statistics && (dispatchers || window_dispatchers)) {
+        m_statistics->delivered(read_time, xpp::event::statistics::now());
+      }
+
       try {
-        for (auto & item : m_dispatchers.at(opcode<Event>())) {
-          item.second->dispatch(event);
+        if (dispatchers) {
+          for (auto & item : *dispatchers) {
+            call(item, event);
+          }
+        }
+
+        if (window_dispatchers) {
+          auto item = std::lower_bound(
+              window_dispatchers->begin(), window_dispatchers->end(), k,
+              [](const window_entry & e, uint32_t value)
+              {
+                return e.m_key < value;
+              });
+          for (; item != window_dispatchers->end() && item->m_key == k;
+               ++item) {
+            call(*item, event);
+          }
         }
       } catch (...) {}
     }
 
+    template<typename Entry, typename Event>
+    static
+    void
+    call(const Entry & entry, const Event & event)
+    {
+      if (entry.m_histogram) {
+        const uint64_t start = xpp::event::statistics::now();
+        entry.m_dispatcher->dispatch(event);
+        entry.m_histogram->record(xpp::event::statistics::now() - start);
+      } else {
+        entry.m_dispatcher->dispatch(event);
+      }
+    }
+
+    xpp::generic::histogram *
+    histogram(detail::dispatcher * d)
+    {
+      // keyed by the address of the complete sink object
+      return m_statistics ? m_statistics->add_sink(dynamic_cast<const void *>(d))
+                          : nullptr;
+    }
+
+    void
+    instrument(priority_slot & slot)
+    {
+      auto * current = slot.load(std::memory_order_relaxed);
+      if (current) {
+        auto * copy = new priority_list(*current);
+        for (auto & item : *copy) {
+          item.m_histogram = histogram(item.m_dispatcher);
+        }
+        slot.store(copy);
+        m_epoch.retire(current);
+      }
+    }
+
+    void
+    instrument(shared_window_list & list)
+    {
+      if (list) {
+        auto copy = std::make_shared<window_list>(*list);
+        for (auto & item : *copy) {
+          item.m_histogram = histogram(item.m_dispatcher);
+        }
+        list = std::move(copy);
+      }
+    }
+
     struct handler {
-      handler(const registry<Connection, Extensions ...> & registry)
+      handler(const registry<Connection, Extensions ...> & registry,
+              uint64_t read_time = 0)
         : m_registry(registry)
+        , m_read_time(read_time)
       {}
 
       const registry<Connection, Extensions ...> & m_registry;
+      uint64_t m_read_time;
+
+      template<typename Event>
+      void
+      operator()(const Event & event) const
+      {
+        m_registry.handle(event, m_read_time);
+      }
+    };
+
+    struct window_finder {
+      xcb_window_t * m_window;
 
       template<typename Event>
       void
       operator()(const Event & event) const
       {
-        m_registry.handle(event);
+        *m_window = detail::window_id(event, 0);
       }
     };
 
-    template<typename Extension>
+    template<typename Handler, typename Extension>
     bool
-    dispatch(const std::shared_ptr<xcb_generic_event_t> & event) const
+    dispatch(const Handler & h, const xpp::generic::event_ptr & event) const
     {
       typedef const typename Extension::template event_dispatcher<Connection> & dispatcher;
-      return static_cast<dispatcher>(*this)(handler(*this), event);
+      return static_cast<dispatcher>(*this)(h, event);
     }
 
-    template<typename Extension, typename Next, typename ... Rest>
+    template<typename Handler, typename Extension, typename Next,
+             typename ... Rest>
     bool
-    dispatch(const std::shared_ptr<xcb_generic_event_t> & event) const
+    dispatch(const Handler & h, const xpp::generic::event_ptr & event) const
     {
-      dispatch<Extension>(event);
-      return dispatch<Next, Rest ...>(event);
+      bool handled = dispatch<Handler, Extension>(h, event);
+      return dispatch<Handler, Next, Rest ...>(h, event) || handled;
     }
 
     template<typename Sink, typename Event>
     void
     attach(priority p, Sink * s)
     {
-      attach(p, s, opcode<Event>());
+      attach(p, s, key<Event>());
     }
 
     template<typename Sink, typename Event, typename Next, typename ... Rest>
     void
     attach(priority p, Sink * s)
     {
-      attach(p, s, opcode<Event>());
+      attach(p, s, key<Event>());
       attach<Sink, Next, Rest ...>(p, s);
     }
 
-    void attach(priority p, detail::dispatcher * d, uint8_t opcode)
+    void attach(priority p, detail::dispatcher * d, uint32_t key)
     {
-      m_dispatchers[opcode].emplace(p, d);
+      auto & dispatchers = key < m_dispatchers.size() ? m_dispatchers[key]
+                                                      : m_ge_dispatchers[key];
+      auto * current = dispatchers.load(std::memory_order_relaxed);
+      std::unique_ptr<priority_list> list(
+          current ? new priority_list(*current) : new priority_list());
+
+      // insert after entries with equal priority to keep attach order
+      auto position = std::upper_bound(list->begin(), list->end(), p,
+          [](priority value, const entry & e) { return value < e.m_priority; });
+      list->insert(position, entry { p, d, histogram(d) });
+
+      dispatchers.store(list.release());
+      m_epoch.retire(current);
     }
 
     template<typename Sink, typename Event>
     void
     detach(priority p, Sink * s)
     {
-      detach(p, s, opcode<Event>());
+      detach(p, s, key<Event>());
     }
 
     template<typename Sink, typename Event, typename Next, typename ... Rest>
     void
     detach(priority p, Sink * s)
     {
-      detach(p, s, opcode<Event>());
+      detach(p, s, key<Event>());
       detach<Sink, Next, Rest ...>(p, s);
     }
 
     void
-    detach(priority p, detail::dispatcher * d, uint8_t opcode)
+    detach(priority p, detail::dispatcher * d, uint32_t key)
     {
-      try {
-        auto & prio_map = m_dispatchers.at(opcode);
-        const auto & prio_sink_pair = prio_map.equal_range(p);
-        for (auto it = prio_sink_pair.first; it != prio_sink_pair.second; ) {
-          if (d == it->second) {
-            it = prio_map.erase(it);
-          } else {
-            ++it;
-          }
+      auto * slot = key < m_dispatchers.size() ? &m_dispatchers[key]
+                                               : m_ge_dispatchers.find(key);
+      auto * current = slot ? slot->load(std::memory_order_relaxed) : nullptr;
+      if (! current) {
+        return;
+      }
+
+      std::unique_ptr<priority_list> list(new priority_list());
+      list->reserve(current->size());
+      for (auto & item : *current) {
+        if (item.m_priority != p || item.m_dispatcher != d) {
+          list->push_back(item);
         }
-      } catch (...) {}
+      }
+
+      if (! list->empty()) {
+        slot->store(list.release());
+      } else if (key < m_dispatchers.size()) {
+        slot->store(nullptr);
+      } else {
+        m_ge_dispatchers.erase(key);
+      }
+      m_epoch.retire(current);
+    }
+
+    void
+    attach(xcb_window_t window, priority p, detail::dispatcher * d,
+           uint32_t key)
+    {
+      auto & dispatchers = m_windows[window];
+      auto list = dispatchers ? std::make_shared<window_list>(*dispatchers)
+                              : std::make_shared<window_list>();
+
+      auto position = std::upper_bound(list->begin(), list->end(),
+          std::make_pair(key, p),
+          [](const std::pair<uint32_t, priority> & value, const window_entry & e)
+          {
+            return value < std::make_pair(e.m_key, e.m_priority);
+          });
+      list->insert(position, window_entry { key, p, d, histogram(d) });
+
+      dispatchers = std::move(list);
+    }
+
+    void
+    detach(xcb_window_t window, priority p, detail::dispatcher * d,
+           uint32_t key)
+    {
+      auto * dispatchers = m_windows.find(window);
+      if (! dispatchers) {
+        return;
+      }
+
+      auto list = std::make_shared<window_list>();
+      list->reserve((*dispatchers)->size());
+      for (auto & item : **dispatchers) {
+        if (item.m_key != key
+            || item.m_priority != p || item.m_dispatcher != d) {
+          list->push_back(item);
+        }
+      }
+
+      if (list->empty()) {
+        m_windows.erase(window);
+      } else {
+        *dispatchers = std::move(list);
+      }
     }
 
 }; // xpp::event::source
@@ -0,0 +1,356 @@
+#ifndef XPP_EVENT_BATCH_HPP
+#define XPP_EVENT_BATCH_HPP
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <xcb/xcb.h>
+
+#include "../generic/event.hpp"
+
+namespace xpp { namespace event {
+
+// Rules for reducing redundant events of the same response type.
+// A rule is called with an earlier event `prev` and the newly arrived event
+// `next`. It returns true if `next` supersedes `prev`, which is then dropped
+// from the batch. A rule may update `next`, e.g. to merge rectangles.
+// Events are only compared with earlier events of the same key, e.g. the same
+// window, so that a batch does not have to be searched as a whole.
+class coalescer
+{
+  public:
+    typedef std::function<bool(const xcb_generic_event_t *,
+                               xcb_generic_event_t *)>
+                                 rule;
+    typedef std::function<uint64_t(const xcb_generic_event_t *)> key;
+
+    struct entry {
+      rule m_rule;
+      // all events of a response type have the same key if empty
+      key m_key;
+      bool m_consecutive;
+    };
+
+    // If consecutive is set, only the directly preceding event is
+    // considered, otherwise all earlier events with the same key.
+    coalescer &
+    set(uint8_t response_type, const rule & r, bool consecutive = false,
+        const key & k = key())
+    {
+      m_rules[response_type & ~0x80] = entry { r, k, consecutive };
+      return *this;
+    }
+
+    coalescer &
+    reset(uint8_t response_type)
+    {
+      m_rules[response_type & ~0x80] = entry { rule(), key(), false };
+      return *this;
+    }
+
+    // nullptr if events of response_type are not coalesced
+    const entry *
+    find(uint8_t response_type) const
+    {
+      auto & e = m_rules[response_type & ~0x80];
+      return e.m_rule ? &e : nullptr;
+    }
+
+    // MotionNotify:    consecutive events for the same window
+    // Expose:          overlapping rectangles of the same window, counts are
+    //                  recomputed by batch
+    // ConfigureNotify: repeated events for the same (event, window)
+    // PropertyNotify:  repeated events for the same (window, atom)
+    static
+    coalescer
+    defaults(void)
+    {
+      coalescer c;
+
+      c.set(XCB_MOTION_NOTIFY,
+          [](const xcb_generic_event_t * prev, xcb_generic_event_t * next)
+          {
+            return as<xcb_motion_notify_event_t>(prev)->event
+                == as<xcb_motion_notify_event_t>(next)->event;
+          }, true);
+
+      c.set(XCB_EXPOSE,
+          [](const xcb_generic_event_t * prev, xcb_generic_event_t * next)
+          {
+            auto p = as<xcb_expose_event_t>(prev);
+            auto n = as<xcb_expose_event_t>(next);
+
+            if (p->window != n->window
+                || p->x >= n->x + n->width || n->x >= p->x + p->width
+                || p->y >= n->y + n->height || n->y >= p->y + p->height) {
+              return false;
+            }
+
+            int x1 = std::max(p->x + p->width, n->x + n->width);
+            int y1 = std::max(p->y + p->height, n->y + n->height);
+            n->x = std::min(p->x, n->x);
+            n->y = std::min(p->y, n->y);
+            n->width = x1 - n->x;
+            n->height = y1 - n->y;
+            return true;
+          }, false,
+          [](const xcb_generic_event_t * e) -> uint64_t
+          {
+            return as<xcb_expose_event_t>(e)->window;
+          });
+
+      c.set(XCB_CONFIGURE_NOTIFY,
+          [](const xcb_generic_event_t * prev, xcb_generic_event_t * next)
+          {
+            auto p = as<xcb_configure_notify_event_t>(prev);
+            auto n = as<xcb_configure_notify_event_t>(next);
+            return p->event == n->event && p->window == n->window;
+          }, false,
+          [](const xcb_generic_event_t * e)
+          {
+            auto c = as<xcb_configure_notify_event_t>(e);
+            return uint64_t(c->event) << 32 | c->window;
+          });
+
+      c.set(XCB_PROPERTY_NOTIFY,
+          [](const xcb_generic_event_t * prev, xcb_generic_event_t * next)
+          {
+            auto p = as<xcb_property_notify_event_t>(prev);
+            auto n = as<xcb_property_notify_event_t>(next);
+            return p->window == n->window && p->atom == n->atom;
+          }, false,
+          [](const xcb_generic_event_t * e)
+          {
+            auto p = as<xcb_property_notify_event_t>(e);
+            return uint64_t(p->window) << 32 | p->atom;
+          });
+
+      return c;
+    }
+
+  private:
+    std::array<entry, 128> m_rules;
+
+    template<typename Event>
+    static
+    Event *
+    as(xcb_generic_event_t * event)
+    {
+      return reinterpret_cast<Event *>(event);
+    }
+
+    template<typename Event>
+    static
+    const Event *
+    as(const xcb_generic_event_t * event)
+    {
+      return reinterpret_cast<const Event *>(event);
+    }
+}; // class coalescer
+
+// Collects all events which are available without blocking, reduces them
+// according to a coalescer and hands the remaining ones to a registry.
+template<typename Connection>
+class batch
+{
+  public:
+    typedef xpp::generic::event_ptr event_ptr;
+    typedef typename std::vector<event_ptr>::const_iterator const_iterator;
+
+    template<typename C>
+    explicit
+    batch(C && c, const coalescer & rules = coalescer::defaults())
+      : m_c(std::forward<C>(c))
+      , m_rules(rules)
+    {}
+
+    coalescer &
+    rules(void)
+    {
+      return m_rules;
+    }
+
+    void
+    push(const event_ptr & event)
+    {
+      auto * r = m_rules.find(event->response_type);
+      if (r && r->m_consecutive) {
+        // the last event is never dropped
+        if (! m_events.empty()
+            && m_events.back()->response_type == event->response_type
+            && r->m_rule(m_events.back().get(), event.get())) {
+          m_events.back().reset();
+          ++m_coalesced;
+        }
+      } else if (r) {
+        auto & pending = m_pending[pending_key(*r, event.get())];
+        // a merged event may supersede events it did not overlap before
+        for (bool merged = true; merged; ) {
+          merged = false;
+          for (auto & i : pending) {
+            if (m_events[i] && r->m_rule(m_events[i].get(), event.get())) {
+              m_events[i].reset();
+              ++m_coalesced;
+              merged = true;
+            }
+          }
+        }
+        pending.erase(std::remove_if(pending.begin(), pending.end(),
+                                     [this](std::size_t i) { return ! m_events[i]; }),
+                      pending.end());
+        pending.push_back(m_events.size());
+      }
+      m_events.push_back(event);
+    }
+
+    // Drains events which libxcb has already read from the socket
+    std::size_t
+    poll(void)
+    {
+      std::size_t n = 0;
+      while (auto event = m_c.poll_for_queued_event()) {
+        push(event);
+        ++n;
+      }
+      return n;
+    }
+
+    // Blocks until at least one event is available
+    std::size_t
+    wait(void)
+    {
+      push(m_c.wait_for_event());
+      return 1 + poll();
+    }
+
+    // Hands the reduced batch in arrival order to registry and clears it
+    template<typename Registry>
+    void
+    dispatch(Registry & registry)
+    {
+      compact();
+      for (auto & event : m_events) {
+        registry.dispatch(event);
+      }
+      clear();
+    }
+
+    const_iterator
+    begin(void)
+    {
+      compact();
+      return m_events.cbegin();
+    }
+
+    const_iterator
+    end(void)
+    {
+      compact();
+      return m_events.cend();
+    }
+
+    std::size_t
+    size(void)
+    {
+      compact();
+      return m_events.size();
+    }
+
+    // Number of events dropped since the last clear()
+    std::size_t
+    coalesced(void) const
+    {
+      return m_coalesced;
+    }
+
+    void
+    clear(void)
+    {
+      m_events.clear();
+      m_pending.clear();
+      m_coalesced = 0;
+      m_compacted = 0;
+    }
+
+  private:
+    // (response type, key of the rule)
+    typedef std::pair<uint8_t, uint64_t> pending_key_type;
+
+    struct pending_hash {
+      std::size_t
+      operator()(const pending_key_type & k) const
+      {
+        return std::hash<uint64_t>()(k.second * 31 + k.first);
+      }
+    };
+
+    Connection m_c;
+    coalescer m_rules;
+    std::vector<event_ptr> m_events;
+    // indices into m_events of events which may still be superseded
+    std::unordered_map<pending_key_type, std::vector<std::size_t>,
+                       pending_hash> m_pending;
+    std::size_t m_coalesced = 0;
+    // m_coalesced at the last compact()
+    std::size_t m_compacted = 0;
+
+    static
+    pending_key_type
+    pending_key(const coalescer::entry & r, const xcb_generic_event_t * e)
+    {
+      return pending_key_type(e->response_type, r.m_key ? r.m_key(e) : 0);
+    }
+
+    void
+    compact(void)
+    {
+      if (m_coalesced == m_compacted) {
+        return;
+      }
+      m_compacted = m_coalesced;
+
+      m_events.erase(std::remove_if(m_events.begin(), m_events.end(),
+                                    [](const event_ptr & e) { return ! e; }),
+                     m_events.end());
+
+      m_pending.clear();
+      for (std::size_t i = 0; i < m_events.size(); ++i) {
+        auto * r = m_rules.find(m_events[i]->response_type);
+        if (r && ! r->m_consecutive) {
+          m_pending[pending_key(*r, m_events[i].get())].push_back(i);
+        }
+      }
+
+      recount();
+    }
+
+    // The count of an Expose event is the number of Expose events which
+    // follow for the same window. The last one of a window keeps its count,
+    // more may follow after the batch.
+    void
+    recount(void)
+    {
+      std::unordered_map<xcb_window_t, uint16_t> following;
+      for (auto e = m_events.rbegin(); e != m_events.rend(); ++e) {
+        if (((*e)->response_type & ~0x80) != XCB_EXPOSE) {
+          continue;
+        }
+        auto expose = reinterpret_cast<xcb_expose_event_t *>(e->get());
+        auto next = following.find(expose->window);
+        if (next != following.end()) {
+          expose->count = next->second + 1;
+          next->second = expose->count;
+        } else {
+          following.emplace(expose->window, expose->count);
+        }
+      }
+    }
+}; // class batch
+
+} } // namespace xpp::event
+
+#endif // XPP_EVENT_BATCH_HPP
@@ -0,0 +1,352 @@
+#ifndef XPP_EVENT_LOOP_HPP
+#define XPP_EVENT_LOOP_HPP
+
+#include <array>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <system_error>
+#include <unordered_map>
+
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include <xcb/xcb.h>
+
+#include "../generic/error.hpp"
+#include "../generic/event.hpp"
+#include "special.hpp"
+
+namespace xpp { namespace event {
+
+// Event loop which multiplexes the X connection, timers and arbitrary file
+// descriptors with epoll. X events are handed to a registry, or anything
+// else with a dispatch(const xpp::generic::event_ptr &) method.
+template<typename Connection, typename Registry>
+class loop
+{
+  public:
+    typedef std::function<void(void)> timer_callback;
+    // called with the epoll events which are ready
+    typedef std::function<void(uint32_t)> fd_callback;
+
+    template<typename C>
+    loop(C && c, Registry & registry)
+      : m_c(std::forward<C>(c))
+      , m_registry(registry)
+      , m_epoll(::epoll_create1(EPOLL_CLOEXEC))
+    {
+      if (m_epoll == -1) {
+        throw std::system_error(errno, std::system_category(), "epoll_create1");
+      }
+
+      m_wakeup = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+      if (m_wakeup == -1) {
+        int error = errno;
+        ::close(m_epoll);
+        throw std::system_error(error, std::system_category(), "eventfd");
+      }
+
+      try {
+        control(EPOLL_CTL_ADD, m_c.get_file_descriptor(), EPOLLIN);
+        control(EPOLL_CTL_ADD, m_wakeup, EPOLLIN);
+      } catch (...) {
+        ::close(m_wakeup);
+        ::close(m_epoll);
+        throw;
+      }
+    }
+
+    loop(const loop &) = delete;
+    loop & operator=(const loop &) = delete;
+
+    ~loop(void)
+    {
+      for (auto & item : m_handlers) {
+        if (item.second.m_timer) {
+          ::close(item.first);
+        }
+      }
+      ::close(m_wakeup);
+      ::close(m_epoll);
+    }
+
+    // Returns an id for remove_timer(). The callback fires once after
+    // timeout, then every interval unless interval is zero.
+    int
+    add_timer(std::chrono::nanoseconds timeout,
+              std::chrono::nanoseconds interval,
+              const timer_callback & callback)
+    {
+      int fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+      if (fd == -1) {
+        throw std::system_error(errno, std::system_category(), "timerfd_create");
+      }
+
+      // a zero timeout would disarm the timer
+      if (timeout <= std::chrono::nanoseconds::zero()) {
+        timeout = std::chrono::nanoseconds(1);
+      }
+
+      itimerspec spec = { timespec_of(interval), timespec_of(timeout) };
+      try {
+        if (::timerfd_settime(fd, 0, &spec, nullptr) == -1) {
+          throw std::system_error(errno, std::system_category(),
+                                  "timerfd_settime");
+        }
+        control(EPOLL_CTL_ADD, fd, EPOLLIN);
+      } catch (...) {
+        ::close(fd);
+        throw;
+      }
+
+      m_handlers[fd] = handler { std::make_shared<fd_callback>(
+          [fd, callback](uint32_t)
+          {
+            uint64_t expirations = 0;
+            if (::read(fd, &expirations, sizeof(expirations)) > 0) {
+              callback();
+            }
+          }), true };
+
+      return fd;
+    }
+
+    void
+    remove_timer(int id)
+    {
+      auto item = m_handlers.find(id);
+      if (item != m_handlers.end() && item->second.m_timer) {
+        m_handlers.erase(item);
+        ::epoll_ctl(m_epoll, EPOLL_CTL_DEL, id, nullptr);
+        ::close(id);
+      }
+    }
+
+    // The file descriptor remains owned by the caller
+    void
+    add(int fd, uint32_t events, const fd_callback & callback)
+    {
+      control(EPOLL_CTL_ADD, fd, events);
+      m_handlers[fd] = handler { std::make_shared<fd_callback>(callback), false };
+    }
+
+    void
+    remove(int fd)
+    {
+      auto item = m_handlers.find(fd);
+      if (item != m_handlers.end() && ! item->second.m_timer) {
+        m_handlers.erase(item);
+        ::epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+      }
+    }
+
+    // Events on special queues are dispatched before those on the main
+    // event queue. Polling an empty special queue reads from the socket,
+    // hence they are polled once per iteration before blocking and when the
+    // connection became readable, not for every queued event. The queue must
+    // outlive its registration.
+    template<typename C>
+    void
+    add(const special_queue<C> & queue)
+    {
+      m_special_queues.push_back(queue.get());
+    }
+
+    template<typename C>
+    void
+    remove(const special_queue<C> & queue)
+    {
+      m_special_queues.erase(std::remove(m_special_queues.begin(),
+                                         m_special_queues.end(),
+                                         queue.get()),
+                             m_special_queues.end());
+    }
+
+    void
+    run(void)
+    {
+      m_running = true;
+      while (m_running) {
+        run_once();
+      }
+    }
+
+    // The connection is broken, see xcb_connection_has_error()
+    bool
+    has_error(void) const
+    {
+      return xcb_connection_has_error(m_c) != 0;
+    }
+
+    // May be called from any thread or from within a handler
+    void
+    stop(void)
+    {
+      m_running = false;
+      wakeup();
+    }
+
+    // Returns from a blocking run_once(), whose next call dispatches what
+    // was queued meanwhile. For another thread which flushed or read from
+    // the connection, e.g. xpp::flush_scheduler::on_deadline_flush().
+    void
+    wakeup(void)
+    {
+      uint64_t one = 1;
+      while (::write(m_wakeup, &one, sizeof(one)) == -1 && errno == EINTR) {}
+    }
+
+    // Dispatches queued events and flushes until no events are left, then
+    // blocks for at most timeout milliseconds (-1: no limit) and handles
+    // whatever became ready. Returns the number of dispatched X events.
+    std::size_t
+    run_once(int timeout = -1)
+    {
+      // handlers waiting for replies may have queued up further events
+      std::size_t n = dispatch_queued();
+      n += drain();
+
+      std::array<epoll_event, 32> events;
+      int ready = ::epoll_wait(m_epoll, events.data(), events.size(), timeout);
+      if (ready == -1) {
+        if (errno == EINTR) {
+          return n;
+        }
+        throw std::system_error(errno, std::system_category(), "epoll_wait");
+      }
+
+      const int xfd = m_c.get_file_descriptor();
+
+      for (int i = 0; i < ready; ++i) {
+        const int fd = events[i].data.fd;
+
+        if (fd == xfd) {
+          // reads from the socket once, everything else is already queued,
+          // special events read along with it as well
+          auto event = m_c.poll_for_event();
+          n += dispatch_special();
+          if (event) {
+            dispatch(event);
+            ++n;
+          } else {
+            m_c.check_connection();
+          }
+          n += dispatch_queued();
+
+        } else if (fd == m_wakeup) {
+          uint64_t value = 0;
+          while (::read(m_wakeup, &value, sizeof(value)) == -1
+                 && errno == EINTR) {}
+
+        } else {
+          auto item = m_handlers.find(fd);
+          if (item != m_handlers.end()) {
+            // keep the callback alive, it might remove itself
+            auto callback = item->second.m_callback;
+            (*callback)(events[i].events);
+          }
+        }
+      }
+
+      return n;
+    }
+
+  private:
+    struct handler {
+      std::shared_ptr<fd_callback> m_callback;
+      bool m_timer;
+    };
+
+    Connection m_c;
+    Registry & m_registry;
+    int m_epoll = -1;
+    int m_wakeup = -1;
+    std::atomic<bool> m_running { false };
+    std::unordered_map<int, handler> m_handlers;
+    std::vector<xcb_special_event_t *> m_special_queues;
+
+    std::size_t
+    dispatch_special(void)
+    {
+      std::size_t n = 0;
+      for (std::size_t i = 0; i < m_special_queues.size(); ++i) {
+        while (auto event = m_c.poll_for_special_event(m_special_queues[i])) {
+          m_registry.dispatch(event);
+          ++n;
+        }
+      }
+      return n;
+    }
+
+    // xcb_flush() also reads while it waits for the socket to become
+    // writable, as do reply waits in handlers and polling special queues.
+    // Events read then never make the socket readable, hence this repeats
+    // until nothing was dispatched.
+    std::size_t
+    drain(void)
+    {
+      std::size_t n = 0;
+      while (true) {
+        m_c.flush();
+        const std::size_t dispatched = dispatch_special() + dispatch_queued();
+        if (dispatched == 0) {
+          return n;
+        }
+        n += dispatched;
+      }
+    }
+
+    // Without a system call
+    std::size_t
+    dispatch_queued(void)
+    {
+      std::size_t n = 0;
+      while (auto event = m_c.poll_for_queued_event()) {
+        dispatch(event);
+        ++n;
+      }
+      return n;
+    }
+
+    void
+    dispatch(const xpp::generic::event_ptr & event)
+    {
+      if (event->response_type == 0) {
+        std::shared_ptr<xcb_generic_event_t> error = event;
+        xpp::generic::dispatch(m_c, std::shared_ptr<xcb_generic_error_t>(
+              error, reinterpret_cast<xcb_generic_error_t *>(event.get())));
+      } else {
+        m_registry.dispatch(event);
+      }
+    }
+
+    void
+    control(int operation, int fd, uint32_t events)
+    {
+      epoll_event event = {};
+      event.events = events;
+      event.data.fd = fd;
+      if (::epoll_ctl(m_epoll, operation, fd, &event) == -1) {
+        throw std::system_error(errno, std::system_category(), "epoll_ctl");
+      }
+    }
+
+    static
+    timespec
+    timespec_of(std::chrono::nanoseconds ns)
+    {
+      auto s = std::chrono::duration_cast<std::chrono::seconds>(ns);
+      return { static_cast<time_t>(s.count()),
+               static_cast<long>((ns - s).count()) };
+    }
+}; // class loop
+
+} } // namespace xpp::event
+
+#endif // XPP_EVENT_LOOP_HPP
@@ -0,0 +1,241 @@
+#ifndef XPP_EVENT_PIPELINE_HPP
+#define XPP_EVENT_PIPELINE_HPP
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <exception>
+#include <functional>
+#include <stdexcept>
+#include <condition_variable>
+
+#include "loop.hpp"
+#include "../generic/event.hpp"
+#include "../generic/spsc_queue.hpp"
+
+namespace xpp { namespace event {
+
+// Runs registry handlers on a pool of worker threads.
+// A reader thread pulls events off the connection and shards them by window
+// onto the workers, so events for one window are handled in order, but
+// different windows proceed in parallel. Events without a window are handled
+// in order on a separate serial lane.
+// Sinks must not be attached or detached while the pipeline is running.
+template<typename Connection, typename Registry>
+class pipeline
+{
+  public:
+    // Called on the reader thread when reading or dispatching throws, e.g.
+    // for X errors. Without a handler the reader stops and stop() rethrows.
+    // With a handler the reader continues, unless the connection is broken.
+    typedef std::function<void(std::exception_ptr)> error_handler;
+
+    template<typename C>
+    pipeline(C && c, Registry & registry,
+             std::size_t workers = std::thread::hardware_concurrency(),
+             std::size_t capacity = 1024)
+      : m_registry(registry)
+      , m_loop(std::forward<C>(c), *this)
+    {
+      // lane 0 is the serial lane
+      const std::size_t lanes = 1 + (workers == 0 ? 1 : workers);
+      for (std::size_t i = 0; i < lanes; ++i) {
+        m_lanes.emplace_back(new lane(capacity));
+      }
+    }
+
+    pipeline(const pipeline &) = delete;
+    pipeline & operator=(const pipeline &) = delete;
+
+    ~pipeline(void)
+    {
+      shutdown();
+    }
+
+    void
+    on_error(const error_handler & handler)
+    {
+      m_error_handler = handler;
+    }
+
+    // Timers and file descriptors added here are handled on the reader thread
+    loop<Connection, pipeline> &
+    event_loop(void)
+    {
+      return m_loop;
+    }
+
+    void
+    start(void)
+    {
+      if (m_reader.joinable()) {
+        throw std::logic_error("xpp::event::pipeline already started");
+      }
+
+      m_exception = nullptr;
+      m_reading = true;
+
+      for (auto & l : m_lanes) {
+        l->m_running = true;
+        lane * current = l.get();
+        l->m_thread = std::thread([this, current] { work(*current); });
+      }
+
+      m_reader = std::thread([this] { read(); });
+    }
+
+    // Waits until all events which were read are handled
+    void
+    stop(void)
+    {
+      shutdown();
+      if (m_exception) {
+        std::exception_ptr exception = m_exception;
+        m_exception = nullptr;
+        std::rethrow_exception(exception);
+      }
+    }
+
+    // Called by the event loop on the reader thread
+    bool
+    dispatch(const xpp::generic::event_ptr & event)
+    {
+      const xcb_window_t window = m_registry.window(event);
+      // fibonacci hashing, as in xpp::generic::xid_map
+      lane & l = window == XCB_NONE
+               ? *m_lanes[0]
+               : *m_lanes[1 + (static_cast<uint32_t>(window * 2654435769u) >> 7)
+                              % (m_lanes.size() - 1)];
+
+      // back pressure: wait until the worker of this lane made room
+      if (! l.m_queue.push(event)) {
+        std::unique_lock<std::mutex> lock(l.m_mutex);
+        l.m_full.store(true, std::memory_order_relaxed);
+        // pairs with the fence in work() after pop()
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        l.m_space.wait(lock, [&] { return l.m_queue.push(event); });
+        l.m_full.store(false, std::memory_order_relaxed);
+      }
+
+      // pairs with the fence in work(): either the worker sees the event, or
+      // the reader sees the worker going to sleep
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (l.m_sleeping.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> guard(l.m_mutex);
+        l.m_wakeup.notify_one();
+      }
+
+      return true;
+    }
+
+  private:
+    struct lane {
+      explicit
+      lane(std::size_t capacity)
+        : m_queue(capacity)
+      {}
+
+      xpp::generic::spsc_queue<xpp::generic::event_ptr> m_queue;
+      std::mutex m_mutex;
+      std::condition_variable m_wakeup;
+      std::atomic<bool> m_sleeping { false };
+      // the reader waits for m_space
+      std::condition_variable m_space;
+      std::atomic<bool> m_full { false };
+      std::atomic<bool> m_running { false };
+      std::thread m_thread;
+    };
+
+    Registry & m_registry;
+    loop<Connection, pipeline> m_loop;
+    std::vector<std::unique_ptr<lane>> m_lanes;
+    std::thread m_reader;
+    std::atomic<bool> m_reading { false };
+    error_handler m_error_handler;
+    std::exception_ptr m_exception;
+
+    void
+    read(void)
+    {
+      while (m_reading) {
+        try {
+          m_loop.run_once();
+        } catch (...) {
+          if (! m_error_handler) {
+            m_exception = std::current_exception();
+            return;
+          }
+          m_error_handler(std::current_exception());
+          // a broken connection stays broken, reading again would only fail
+          // again
+          if (m_loop.has_error()) {
+            return;
+          }
+        }
+      }
+    }
+
+    void
+    work(lane & l)
+    {
+      xpp::generic::event_ptr event;
+
+      while (true) {
+        if (l.m_queue.pop(event)) {
+          std::atomic_thread_fence(std::memory_order_seq_cst);
+          if (l.m_full.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> guard(l.m_mutex);
+            l.m_space.notify_one();
+          }
+
+          m_registry.dispatch(event);
+          event.reset();
+          continue;
+        }
+
+        std::unique_lock<std::mutex> lock(l.m_mutex);
+        l.m_sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        // drain everything before leaving
+        if (l.m_queue.empty() && ! l.m_running) {
+          l.m_sleeping.store(false, std::memory_order_relaxed);
+          return;
+        }
+
+        l.m_wakeup.wait(lock, [&l]
+            {
+              return ! l.m_queue.empty() || ! l.m_running;
+            });
+        l.m_sleeping.store(false, std::memory_order_relaxed);
+      }
+    }
+
+    void
+    shutdown(void)
+    {
+      if (m_reader.joinable()) {
+        m_reading = false;
+        m_loop.stop();
+        m_reader.join();
+      }
+
+      // the reader is gone, nothing is pushed anymore
+      for (auto & l : m_lanes) {
+        if (l->m_thread.joinable()) {
+          {
+            std::lock_guard<std::mutex> guard(l->m_mutex);
+            l->m_running = false;
+          }
+          l->m_wakeup.notify_all();
+          l->m_thread.join();
+        }
+      }
+    }
+}; // class pipeline
+
+} } // namespace xpp::event
+
+#endif // XPP_EVENT_PIPELINE_HPP
@@ -0,0 +1,303 @@
+#ifndef XPP_EVENT_RECORDER_HPP
+#define XPP_EVENT_RECORDER_HPP
+
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <utility> // declval
+#include <typeindex>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h> // xcb_extension_t::name
+
+#include "../proto/x.hpp"
+#include "../generic/event.hpp"
+
+// File format, integers in host byte order:
+//   header:    "XPPEVREC", uint32_t version, uint32_t number of extensions
+//   extension: uint32_t name length, name, xcb_query_extension_reply_t
+//   event:     uint64_t nanoseconds since start, uint32_t size, event
+// Events are stored as libxcb returns them: 36 bytes (including
+// full_sequence), followed by 4 * length bytes for XGE events.
+
+namespace xpp { namespace event {
+
+namespace detail {
+
+static const char recording_magic[8] = { 'X', 'P', 'P', 'E', 'V', 'R', 'E', 'C' };
+static const uint32_t recording_version = 1;
+
+inline
+std::size_t
+event_size(const xcb_generic_event_t & event)
+{
+  std::size_t size = sizeof(xcb_generic_event_t);
+  if ((event.response_type & ~0x80) == XCB_GE_GENERIC) {
+    size += 4 * reinterpret_cast<const xcb_ge_generic_event_t &>(event).length;
+  }
+  return size;
+}
+
+} // namespace detail
+
+// Writes events to a file, e.g. with
+//   c.observe_events(std::ref(recorder));
+class recorder
+{
+  public:
+    // Extensions are generated xpp::<ext>::extension objects. Their data is
+    // stored so events can be dispatched without the recorded server.
+    template<typename ... Extensions>
+    explicit
+    recorder(const std::string & path, const Extensions & ... extensions)
+      : m_out(path, std::ios::binary | std::ios::trunc)
+    {
+      if (! m_out) {
+        throw std::runtime_error("xpp::event::recorder: cannot open " + path);
+      }
+
+      const uint32_t n = sizeof ... (Extensions);
+      m_out.write(detail::recording_magic, sizeof(detail::recording_magic));
+      write(detail::recording_version);
+      write(n);
+      write_extensions(extensions ...);
+    }
+
+    recorder(const recorder &) = delete;
+    recorder & operator=(const recorder &) = delete;
+
+    void
+    operator()(const xcb_generic_event_t & event)
+    {
+      const uint64_t timestamp =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - m_start).count();
+      const uint32_t size = detail::event_size(event);
+
+      std::lock_guard<std::mutex> guard(m_mutex);
+      write(timestamp);
+      write(size);
+      m_out.write(reinterpret_cast<const char *>(&event), size);
+    }
+
+    void
+    flush(void)
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      m_out.flush();
+    }
+
+  private:
+    std::mutex m_mutex;
+    std::ofstream m_out;
+    const std::chrono::steady_clock::time_point m_start =
+      std::chrono::steady_clock::now();
+
+    template<typename T>
+    void
+    write(const T & value)
+    {
+      m_out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    void
+    write_extensions(void)
+    {}
+
+    template<typename Extension, typename ... Rest>
+    void
+    write_extensions(const Extension & extension, const Rest & ... rest)
+    {
+      const std::string name = Extension::id()->name;
+      const uint32_t length = name.size();
+      const xcb_query_extension_reply_t * reply = extension;
+      xcb_query_extension_reply_t empty = {};
+
+      write(length);
+      m_out.write(name.data(), length);
+      write(reply ? *reply : empty);
+      write_extensions(rest ...);
+    }
+}; // class recorder
+
+// Stands in for a connection when dispatching recorded events, it only knows
+// the extension data of the recorded server.
+class offline_connection
+{
+  public:
+    offline_connection(void)
+    {}
+
+    // extensions refer to the data of this connection
+    offline_connection(const offline_connection &) = delete;
+    offline_connection & operator=(const offline_connection &) = delete;
+
+    void
+    add(const std::string & name, const xcb_query_extension_reply_t & reply)
+    {
+      m_replies[name] = reply;
+    }
+
+    // Extensions missing from the recording are reported as not present
+    template<typename Extension>
+    const Extension &
+    extension(void) const
+    {
+      return get<Extension>(0);
+    }
+
+  private:
+    std::map<std::string, xcb_query_extension_reply_t> m_replies;
+    mutable std::unordered_map<std::type_index, std::shared_ptr<void>> m_extensions;
+    xcb_query_extension_reply_t m_missing = {};
+
+    template<typename Extension>
+    auto
+    get(int) const -> decltype(Extension::id(), std::declval<const Extension &>())
+    {
+      auto & extension = m_extensions[typeid(Extension)];
+      if (! extension) {
+        auto reply = m_replies.find(Extension::id()->name);
+        extension = std::make_shared<Extension>(
+            reply == m_replies.end() ? &m_missing : &reply->second);
+      }
+      return *static_cast<const Extension *>(extension.get());
+    }
+
+    // xpp::x::extension
+    template<typename Extension>
+    const Extension &
+    get(long) const
+    {
+      static const Extension extension {};
+      return extension;
+    }
+}; // class offline_connection
+
+// Reads a file written by recorder
+class player
+{
+  public:
+    explicit
+    player(const std::string & path)
+      : m_in(path, std::ios::binary)
+    {
+      char magic[sizeof(detail::recording_magic)];
+      uint32_t version = 0;
+      uint32_t n = 0;
+
+      if (! m_in.read(magic, sizeof(magic))
+          || std::memcmp(magic, detail::recording_magic, sizeof(magic)) != 0
+          || ! read(version) || version != detail::recording_version
+          || ! read(n)) {
+        throw std::runtime_error("xpp::event::player: invalid recording " + path);
+      }
+
+      for (uint32_t i = 0; i < n; ++i) {
+        uint32_t length = 0;
+        xcb_query_extension_reply_t reply;
+        std::string name;
+
+        if (read(length)) {
+          name.resize(length);
+          if (length == 0 || m_in.read(&name[0], length)) {
+            read(reply);
+          }
+        }
+
+        if (! m_in) {
+          throw std::runtime_error("xpp::event::player: invalid recording " + path);
+        }
+
+        m_connection.add(name, reply);
+      }
+    }
+
+    player(const player &) = delete;
+    player & operator=(const player &) = delete;
+
+    // For the registry the events are dispatched to
+    const offline_connection &
+    connection(void) const
+    {
+      return m_connection;
+    }
+
+    // Empty at the end of the recording
+    xpp::generic::event_ptr
+    next(void)
+    {
+      uint64_t timestamp = 0;
+      uint32_t size = 0;
+      if (! read(timestamp) || ! read(size) || size < sizeof(xcb_generic_event_t)) {
+        return nullptr;
+      }
+
+      auto * event = static_cast<xcb_generic_event_t *>(std::malloc(size));
+      if (! event) {
+        throw std::bad_alloc();
+      }
+
+      if (! m_in.read(reinterpret_cast<char *>(event), size)) {
+        std::free(event);
+        return nullptr;
+      }
+
+      m_timestamp = std::chrono::nanoseconds(timestamp);
+      return m_events->make(event);
+    }
+
+    // Of the event last returned by next()
+    std::chrono::nanoseconds
+    timestamp(void) const
+    {
+      return m_timestamp;
+    }
+
+    // Dispatches all remaining events, either as fast as possible or with
+    // the timing of the recording. Returns the number of events.
+    template<typename Registry>
+    std::size_t
+    play(const Registry & registry, bool realtime = false)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      std::size_t n = 0;
+
+      while (auto event = next()) {
+        if (realtime) {
+          std::this_thread::sleep_until(start + m_timestamp);
+        }
+        registry.dispatch(event);
+        ++n;
+      }
+
+      return n;
+    }
+
+  private:
+    std::ifstream m_in;
+    offline_connection m_connection;
+    std::chrono::nanoseconds m_timestamp { 0 };
+    std::shared_ptr<xpp::generic::event_pool> m_events =
+      xpp::generic::event_pool::create();
+
+    template<typename T>
+    bool
+    read(T & value)
+    {
+      return static_cast<bool>(
+          m_in.read(reinterpret_cast<char *>(&value), sizeof(T)));
+    }
+}; // class player
+
+} } // namespace xpp::event
+
+#endif // XPP_EVENT_RECORDER_HPP
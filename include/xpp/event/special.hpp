@@ -0,0 +1,91 @@
+#ifndef XPP_EVENT_SPECIAL_HPP
+#define XPP_EVENT_SPECIAL_HPP
+
+#include <cstdint>
+#include <utility> // forward
+
+#include <xcb/xcb.h>
+
+#include "../generic/event.hpp"
+
+namespace xpp { namespace event {
+
+// Owns a special event queue of libxcb (xcb_register_for_special_xge()).
+// XGE events of the extension which carry the event id eid are put on this
+// queue instead of the main event queue. Unregisters on destruction.
+template<typename Connection>
+class special_queue
+{
+  public:
+    template<typename C>
+    special_queue(C && c, xcb_extension_t * extension, uint32_t eid,
+                  uint32_t * stamp = nullptr)
+      : m_c(std::forward<C>(c))
+      , m_queue(m_c.register_for_special_xge(extension, eid, stamp))
+    {}
+
+    // Extension is a generated xpp::<ext>::extension
+    template<typename Extension, typename C>
+    static
+    special_queue
+    make(C && c, uint32_t eid, uint32_t * stamp = nullptr)
+    {
+      return special_queue(std::forward<C>(c), Extension::id(), eid, stamp);
+    }
+
+    special_queue(special_queue && other)
+      : m_c(std::forward<Connection>(other.m_c))
+      , m_queue(other.m_queue)
+    {
+      other.m_queue = nullptr;
+    }
+
+    special_queue(const special_queue &) = delete;
+    special_queue & operator=(const special_queue &) = delete;
+
+    ~special_queue(void)
+    {
+      if (m_queue) {
+        m_c.unregister_for_special_event(m_queue);
+      }
+    }
+
+    xcb_special_event_t *
+    get(void) const
+    {
+      return m_queue;
+    }
+
+    xpp::generic::event_ptr
+    poll(void) const
+    {
+      return m_c.poll_for_special_event(m_queue);
+    }
+
+    xpp::generic::event_ptr
+    wait(void) const
+    {
+      return m_c.wait_for_special_event(m_queue);
+    }
+
+    // Dispatches all queued events, returns their number
+    template<typename Registry>
+    std::size_t
+    dispatch(const Registry & registry) const
+    {
+      std::size_t n = 0;
+      while (auto event = poll()) {
+        registry.dispatch(event);
+        ++n;
+      }
+      return n;
+    }
+
+  private:
+    Connection m_c;
+    xcb_special_event_t * m_queue;
+}; // class special_queue
+
+} } // namespace xpp::event
+
+#endif // XPP_EVENT_SPECIAL_HPP
@@ -0,0 +1,320 @@
+#ifndef XPP_EVENT_STATIC_REGISTRY_HPP
+#define XPP_EVENT_STATIC_REGISTRY_HPP
+
+#include <array>
+#include <tuple>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+#include "../event.hpp"
+#include "../generic/epoch.hpp"
+
+namespace xpp { namespace event {
+
+namespace detail {
+
+template<typename Event, typename ... Events>
+struct contains;
+
+template<typename Event>
+struct contains<Event> : std::false_type {};
+
+template<typename Event, typename First, typename ... Rest>
+struct contains<Event, First, Rest ...>
+  : std::integral_constant<bool, std::is_same<Event, First>::value
+                                 || contains<Event, Rest ...>::value>
+{};
+
+} // namespace detail
+
+// Registry for a fixed set of event types.
+// Opcodes of these events are resolved once into a table, dispatching an event
+// is a single lookup and sinks are called without a dynamic_cast. Events of
+// other types are dropped by the lookup, extensions without subscribed events
+// are never consulted. Unlike registry, sinks are not routed by window.
+template<typename Connection, typename ... Events>
+class static_registry
+{
+  public:
+    typedef unsigned int priority;
+
+    template<typename C>
+    explicit
+    static_registry(C && c)
+      : m_c(std::forward<C>(c))
+    {
+      int expand[] = { 0, (add<Events>(), 0) ... };
+      (void)expand;
+    }
+
+    ~static_registry(void)
+    {
+      int expand[] = {
+        0, (delete std::get<sink_slot<Events>>(m_sinks).load(), 0) ... };
+      (void)expand;
+    }
+
+    bool
+    dispatch(const xpp::generic::event_ptr & event) const
+    {
+      const slot * s = find(event);
+      if (s) {
+        (this->*s->m_handle)(event, s->m_first_event);
+      }
+      return s != nullptr;
+    }
+
+    xcb_window_t
+    window(const xpp::generic::event_ptr & event) const
+    {
+      const slot * s = find(event);
+      return s ? (this->*s->m_window)(event, s->m_first_event) : XCB_NONE;
+    }
+
+    // Like registry, may be called while another thread dispatches, but not
+    // concurrently with another attach() or detach()
+    template<typename Event, typename ... Rest>
+    void
+    attach(priority p, sink<Event, Rest ...> * s)
+    {
+      int expand[] = { (attach_one<Event>(p, s), 0), (attach_one<Rest>(p, s), 0) ... };
+      (void)expand;
+    }
+
+    template<typename Event, typename ... Rest>
+    void
+    detach(priority p, sink<Event, Rest ...> * s)
+    {
+      int expand[] = { (detach_one<Event>(p, s), 0), (detach_one<Rest>(p, s), 0) ... };
+      (void)expand;
+    }
+
+  private:
+    typedef void (static_registry::*handle_function)(
+        const xpp::generic::event_ptr &, uint8_t) const;
+    typedef xcb_window_t (static_registry::*window_function)(
+        const xpp::generic::event_ptr &, uint8_t) const;
+
+    struct slot {
+      handle_function m_handle;
+      window_function m_window;
+      uint8_t m_first_event;
+    };
+
+    // sorted by priority, replaced as a whole and retired like in registry
+    template<typename Event>
+    using sink_list = std::vector<std::pair<priority, detail::sink<Event> *>>;
+
+    template<typename Event>
+    using sink_slot = std::atomic<const sink_list<Event> *>;
+
+    Connection m_c;
+    // indexed by opcode
+    std::array<slot, 256> m_slots {};
+    // XGE events, by detail::ge_key()
+    std::vector<std::pair<uint32_t, slot>> m_ge_slots;
+    // XKB events share the response type first_event, the xkbType in pad0
+    // tells them apart. By first_event << 8 | xkbType.
+    std::vector<std::pair<uint16_t, slot>> m_subtype_slots;
+    std::tuple<sink_slot<Events> ...> m_sinks;
+    xpp::generic::epoch m_epoch;
+
+    const slot *
+    find(const xpp::generic::event_ptr & event) const
+    {
+      const uint8_t opcode = event->response_type & ~0x80;
+
+      if (opcode == XCB_GE_GENERIC && ! m_ge_slots.empty()) {
+        auto * ge = reinterpret_cast<const xcb_ge_generic_event_t *>(event.get());
+        const uint32_t key =
+          (1u << 24) | (ge->extension << 16) | ge->event_type;
+        for (auto & item : m_ge_slots) {
+          if (item.first == key) {
+            return &item.second;
+          }
+        }
+      }
+
+      if (! m_subtype_slots.empty()) {
+        const uint16_t key = opcode << 8 | event->pad0;
+        for (auto & item : m_subtype_slots) {
+          if (item.first == key) {
+            return &item.second;
+          }
+        }
+      }
+
+      return m_slots[opcode].m_handle ? &m_slots[opcode] : nullptr;
+    }
+
+    template<typename Event>
+    void
+    add(void)
+    {
+      auto & extension = m_c.template extension<typename Event::extension>();
+      const slot s = { &static_registry::handle<Event>,
+                       &static_registry::window<Event>,
+                       first_event(extension) };
+
+      const uint32_t ge_key = detail::ge_key<Event>(extension, 0);
+      if (ge_key != 0) {
+        m_ge_slots.emplace_back(ge_key, s);
+      } else if (subtyped(extension)) {
+        m_subtype_slots.emplace_back(s.m_first_event << 8 | Event::opcode(), s);
+      } else {
+        m_slots[opcode<Event>(extension)] = s;
+      }
+    }
+
+    template<typename Event>
+    static
+    uint8_t
+    opcode(const xpp::x::extension &)
+    {
+      return Event::opcode();
+    }
+
+    template<typename Event, typename Extension>
+    static
+    uint8_t
+    opcode(const Extension & extension)
+    {
+      return Event::opcode(extension);
+    }
+
+    static
+    uint8_t
+    first_event(const xpp::x::extension &)
+    {
+      return 0;
+    }
+
+    static
+    bool
+    subtyped(const xpp::x::extension &)
+    {
+      return false;
+    }
+
+    template<typename Extension>
+    static
+    bool
+    subtyped(const Extension &)
+    {
+      return Extension::id()
+          && std::strcmp(Extension::id()->name, "XKEYBOARD") == 0;
+    }
+
+    template<typename Extension>
+    static
+    uint8_t
+    first_event(const Extension & extension)
+    {
+      return extension->first_event;
+    }
+
+    template<typename Event>
+    Event
+    make(const xpp::generic::event_ptr & event, uint8_t first_event) const
+    {
+      return make<Event>(event, first_event,
+          std::is_same<typename Event::extension, xpp::x::extension>());
+    }
+
+    template<typename Event>
+    Event
+    make(const xpp::generic::event_ptr & event, uint8_t, std::true_type) const
+    {
+      return Event(m_c, event);
+    }
+
+    template<typename Event>
+    Event
+    make(const xpp::generic::event_ptr & event, uint8_t first_event,
+         std::false_type) const
+    {
+      return Event(m_c, first_event, event);
+    }
+
+    template<typename Event>
+    void
+    handle(const xpp::generic::event_ptr & event, uint8_t first_event) const
+    {
+      const xpp::generic::epoch::guard guard(m_epoch);
+      auto * sinks = std::get<sink_slot<Event>>(m_sinks).load();
+      if (! sinks) {
+        return;
+      }
+
+      const Event e = make<Event>(event, first_event);
+      try {
+        for (auto & item : *sinks) {
+          item.second->handle(e);
+        }
+      } catch (...) {}
+    }
+
+    template<typename Event>
+    xcb_window_t
+    window(const xpp::generic::event_ptr & event, uint8_t first_event) const
+    {
+      return detail::window_id(make<Event>(event, first_event), 0);
+    }
+
+    template<typename Event>
+    void
+    attach_one(priority p, detail::sink<Event> * s)
+    {
+      static_assert(detail::contains<Event, Events ...>::value,
+                    "event type is not handled by this static_registry");
+
+      auto & sinks = std::get<sink_slot<Event>>(m_sinks);
+      auto * current = sinks.load(std::memory_order_relaxed);
+      std::unique_ptr<sink_list<Event>> list(
+          current ? new sink_list<Event>(*current) : new sink_list<Event>());
+
+      // insert after entries with equal priority to keep attach order
+      auto position = std::upper_bound(list->begin(), list->end(), p,
+          [](priority value, const std::pair<priority, detail::sink<Event> *> & e)
+          {
+            return value < e.first;
+          });
+      list->emplace(position, p, s);
+
+      sinks.store(list.release());
+      m_epoch.retire(current);
+    }
+
+    template<typename Event>
+    void
+    detach_one(priority p, detail::sink<Event> * s)
+    {
+      static_assert(detail::contains<Event, Events ...>::value,
+                    "event type is not handled by this static_registry");
+
+      auto & sinks = std::get<sink_slot<Event>>(m_sinks);
+      auto * current = sinks.load(std::memory_order_relaxed);
+      if (! current) {
+        return;
+      }
+
+      std::unique_ptr<sink_list<Event>> list(new sink_list<Event>());
+      for (auto & item : *current) {
+        if (item.first != p || item.second != s) {
+          list->push_back(item);
+        }
+      }
+
+      sinks.store(list->empty() ? nullptr : list.release());
+      m_epoch.retire(current);
+    }
+}; // class static_registry
+
+} } // namespace xpp::event
+
+#endif // XPP_EVENT_STATIC_REGISTRY_HPP
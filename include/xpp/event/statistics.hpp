@@ -0,0 +1,140 @@
+#ifndef XPP_EVENT_STATISTICS_HPP
+#define XPP_EVENT_STATISTICS_HPP
+
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+
+#include "../generic/histogram.hpp"
+
+namespace xpp { namespace event {
+
+// Measurements of the event path, shared by a connection and a registry:
+//   c.instrument(statistics);
+//   registry.instrument(statistics);
+// All durations are in nanoseconds.
+class statistics
+{
+  public:
+    statistics(void)
+    {
+      for (auto & n : m_events) {
+        n.store(0, std::memory_order_relaxed);
+      }
+    }
+
+    statistics(const statistics &) = delete;
+    statistics & operator=(const statistics &) = delete;
+
+    static
+    uint64_t
+    now(void)
+    {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // From reading an event off the connection until it is handed to the
+    // first sink
+    const xpp::generic::histogram &
+    latency(void) const
+    {
+      return m_latency;
+    }
+
+    // Other events read and still referenced, e.g. queued, at the time an
+    // event is dispatched. Errors are not counted.
+    const xpp::generic::histogram &
+    queue_depth(void) const
+    {
+      return m_queue_depth;
+    }
+
+    // Time spent in sink s, nullptr if s was never called
+    const xpp::generic::histogram *
+    sink(const void * s) const
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      auto item = m_sinks.find(s);
+      return item == m_sinks.end() ? nullptr : item->second.get();
+    }
+
+    // Number of dispatched events with response type opcode. Sample twice
+    // for a rate.
+    uint64_t
+    events(uint8_t opcode) const
+    {
+      return m_events[opcode].load(std::memory_order_relaxed);
+    }
+
+    int64_t
+    in_flight(void) const
+    {
+      return m_in_flight.load(std::memory_order_relaxed);
+    }
+
+    // Called by the connection for each event it stamps
+    void
+    read(void)
+    {
+      m_in_flight.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Called when the last handle on a stamped event is released, whether it
+    // was dispatched, coalesced away or dropped
+    void
+    released(void)
+    {
+      m_in_flight.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Called by the registry, returns the histogram for sink s
+    xpp::generic::histogram *
+    add_sink(const void * s)
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      auto & h = m_sinks[s];
+      if (! h) {
+        h.reset(new xpp::generic::histogram);
+      }
+      return h.get();
+    }
+
+    // Called by the registry
+    void
+    dispatch(uint8_t opcode, uint64_t read_time)
+    {
+      m_events[opcode].fetch_add(1, std::memory_order_relaxed);
+      if (read_time != 0) {
+        // not counting the dispatched event itself
+        const int64_t depth =
+          m_in_flight.load(std::memory_order_relaxed) - 1;
+        m_queue_depth.record(depth > 0 ? depth : 0);
+      }
+    }
+
+    void
+    delivered(uint64_t read_time, uint64_t time)
+    {
+      if (read_time != 0 && time > read_time) {
+        m_latency.record(time - read_time);
+      }
+    }
+
+  private:
+    xpp::generic::histogram m_latency;
+    xpp::generic::histogram m_queue_depth;
+    std::array<std::atomic<uint64_t>, 256> m_events;
+    std::atomic<int64_t> m_in_flight { 0 };
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<const void *, std::unique_ptr<xpp::generic::histogram>> m_sinks;
+}; // class statistics
+
+} } // namespace xpp::event
+
+#endif // XPP_EVENT_STATISTICS_HPP
@@ -0,0 +1,217 @@
+#ifndef XPP_FLUSH_SCHEDULER_HPP
+#define XPP_FLUSH_SCHEDULER_HPP
+
+#include <mutex>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+#include <xcb/xcb.h>
+
+#include "generic/flush_policy.hpp"
+#include "generic/histogram.hpp"
+
+namespace xpp {
+
+// Flushes a connection when the requests sent since the last flush exceed a
+// size or count, or when the first of them has waited for deadline. Sizes
+// are those of request_info, value lists are not included. A threshold or
+// deadline of 0 is disabled. core::flush() flushes through the scheduler too,
+// e.g. before the event loop blocks.
+// Deadlines are served by a thread, which is started on first use. Its
+// flushes may read events into xcb's queue behind the back of an event loop
+// blocked in epoll, see on_deadline_flush().
+// A scheduler belongs to the one connection it was constructed with, e.g.
+//   c.schedule_flushes(std::make_shared<xpp::flush_scheduler>(c, 32 * 1024));
+class flush_scheduler
+  : public xpp::generic::flush_policy
+{
+  public:
+    typedef std::chrono::steady_clock clock;
+
+    explicit
+    flush_scheduler(xcb_connection_t * c,
+                    std::size_t bytes = 0, std::size_t requests = 0,
+                    clock::duration deadline = std::chrono::milliseconds(1))
+      : m_c(c)
+      , m_max_bytes(bytes)
+      , m_max_requests(requests)
+      , m_deadline(deadline)
+    {}
+
+    flush_scheduler(const flush_scheduler &) = delete;
+    flush_scheduler & operator=(const flush_scheduler &) = delete;
+
+    virtual
+    ~flush_scheduler(void)
+    {
+      {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_stop = true;
+      }
+      m_wakeup.notify_one();
+      if (m_thread.joinable()) {
+        m_thread.join();
+      }
+    }
+
+    xcb_connection_t *
+    connection(void) const
+    {
+      return m_c;
+    }
+
+    // core::schedule_flushes() ensures that c is the connection of the
+    // scheduler
+    void
+    sent(xcb_connection_t * c, const xpp::generic::request_info & request)
+    {
+      assert(c == m_c);
+      (void)c;
+      const std::size_t bytes =
+        m_bytes.fetch_add(request.m_size, std::memory_order_relaxed)
+        + request.m_size;
+      const std::size_t requests =
+        m_requests.fetch_add(1, std::memory_order_relaxed) + 1;
+
+      if ((m_max_bytes != 0 && bytes >= m_max_bytes)
+          || (m_max_requests != 0 && requests >= m_max_requests)) {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        flush(m_threshold_flushes);
+      } else if (requests == 1 && m_deadline != clock::duration::zero()) {
+        arm();
+      }
+    }
+
+    int
+    flush(xcb_connection_t * c)
+    {
+      assert(c == m_c);
+      (void)c;
+      std::lock_guard<std::mutex> guard(m_mutex);
+      return flush(m_explicit_flushes);
+    }
+
+    // Called on the deadline thread after it flushed, without locks held.
+    // An xpp::event::loop must be woken up here, it does not see events
+    // which the flush read, e.g.
+    //   scheduler->on_deadline_flush([&loop] { loop.wakeup(); });
+    void
+    on_deadline_flush(const std::function<void(void)> & callback)
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      m_on_deadline_flush = callback;
+    }
+
+    // Bytes written by flushes which wrote anything. Bytes which xcb writes
+    // on its own when its buffer is full are not included.
+    const xpp::generic::histogram &
+    bytes_per_flush(void) const
+    {
+      return m_bytes_per_flush;
+    }
+
+    uint64_t
+    threshold_flushes(void) const
+    {
+      return m_threshold_flushes.load(std::memory_order_relaxed);
+    }
+
+    uint64_t
+    deadline_flushes(void) const
+    {
+      return m_deadline_flushes.load(std::memory_order_relaxed);
+    }
+
+    // flush() of the connection, e.g. before the event loop blocks
+    uint64_t
+    explicit_flushes(void) const
+    {
+      return m_explicit_flushes.load(std::memory_order_relaxed);
+    }
+
+  protected:
+    xcb_connection_t * const m_c;
+    const std::size_t m_max_bytes;
+    const std::size_t m_max_requests;
+    const clock::duration m_deadline;
+
+    // since the last flush
+    std::atomic<std::size_t> m_bytes { 0 };
+    std::atomic<std::size_t> m_requests { 0 };
+
+    xpp::generic::histogram m_bytes_per_flush;
+    std::atomic<uint64_t> m_threshold_flushes { 0 };
+    std::atomic<uint64_t> m_deadline_flushes { 0 };
+    std::atomic<uint64_t> m_explicit_flushes { 0 };
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::thread m_thread;
+    bool m_stop = false;
+    std::function<void(void)> m_on_deadline_flush;
+    // clock::time_point::max(): no deadline
+    clock::time_point m_due = clock::time_point::max();
+
+    // m_mutex must be locked
+    int
+    flush(std::atomic<uint64_t> & counter)
+    {
+      // requests sent from now on are flushed here or arm the deadline again
+      m_bytes.store(0, std::memory_order_relaxed);
+      m_requests.store(0, std::memory_order_relaxed);
+      m_due = clock::time_point::max();
+
+      const uint64_t before = xcb_total_written(m_c);
+      const int result = xcb_flush(m_c);
+      const uint64_t written = xcb_total_written(m_c) - before;
+      if (written != 0) {
+        m_bytes_per_flush.record(written);
+        counter.fetch_add(1, std::memory_order_relaxed);
+      }
+      return result;
+    }
+
+    void
+    arm(void)
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      if (m_due != clock::time_point::max()) {
+        return;
+      }
+      m_due = clock::now() + m_deadline;
+      if (! m_thread.joinable()) {
+        m_thread = std::thread([this] { run(); });
+      } else {
+        m_wakeup.notify_one();
+      }
+    }
+
+    void
+    run(void)
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      while (! m_stop) {
+        if (m_due == clock::time_point::max()) {
+          m_wakeup.wait(lock);
+        } else if (clock::now() >= m_due) {
+          flush(m_deadline_flushes);
+          if (m_on_deadline_flush) {
+            auto callback = m_on_deadline_flush;
+            lock.unlock();
+            callback();
+            lock.lock();
+          }
+        } else {
+          m_wakeup.wait_until(lock, m_due);
+        }
+      }
+    }
+}; // class flush_scheduler
+
+} // namespace xpp
+
+#endif // XPP_FLUSH_SCHEDULER_HPP
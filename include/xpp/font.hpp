@@ -36,10 +36,7 @@ class font
                   {
                     xpp::x::open_font(c, font, name);
                   },
-                  [&](const Connection & c, const xcb_font_t & font)
-                  {
-                    xpp::x::close_font(c, font);
-                  });
+                  xpp::generic::free_function { &xcb_close_font, &xcb_close_font_checked });
     }
 
     template<typename C>
@@ -52,13 +49,16 @@ class font
                   {
                     xpp::x::open_font_checked(c, font, name);
                   },
-                  [&](const Connection & c, const xcb_font_t & font)
-                  {
-                    xpp::x::close_font_checked(c, font);
-                  });
+                  xpp::generic::free_function { &xcb_close_font, &xcb_close_font_checked });
     }
 };
 
+// Non-owning handle, copying it does not allocate
+template<typename Connection, template<typename, typename> class ... Interfaces>
+using borrowed_font =
+  xpp::generic::borrowed_resource<Connection, xcb_font_t,
+                                  xpp::x::font, Interfaces ...>;
+
 namespace generic {
 
 template<typename Connection, template<typename, typename> class ... Interfaces>
@@ -0,0 +1,251 @@
+#ifndef XPP_FONT_METRICS_HPP
+#define XPP_FONT_METRICS_HPP
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+
+#include "proto/x.hpp"
+
+namespace xpp {
+
+// Same fields as a QueryTextExtents reply
+struct text_extents {
+  uint8_t m_draw_direction;
+  int16_t m_font_ascent;
+  int16_t m_font_descent;
+  int16_t m_overall_ascent;
+  int16_t m_overall_descent;
+  int32_t m_overall_width;
+  int32_t m_overall_left;
+  int32_t m_overall_right;
+};
+
+// The metrics of a core font from a single QueryFont reply. Text extents are
+// computed like the server does for QueryTextExtents: characters which do not
+// exist are replaced by the default character or ignored.
+class font_metrics
+{
+  public:
+    explicit
+    font_metrics(const xcb_query_font_reply_t * reply)
+      : m_info(*reply)
+      , m_columns(reply->max_char_or_byte2 - reply->min_char_or_byte2 + 1)
+      , m_char_infos(xcb_query_font_char_infos(reply),
+                     xcb_query_font_char_infos(reply)
+                       + xcb_query_font_char_infos_length(reply))
+    {
+      // the trailing lists are not copied
+      m_info.length = 0;
+      m_info.properties_len = 0;
+      m_info.char_infos_len = m_char_infos.size();
+    }
+
+    // One round trip, fontable is a font or a gcontext
+    template<typename Connection>
+    static
+    font_metrics
+    query(Connection && c, xcb_fontable_t fontable)
+    {
+      auto reply = xpp::x::query_font(std::forward<Connection>(c), fontable);
+      return font_metrics(reply.get().get());
+    }
+
+    const xcb_query_font_reply_t &
+    info(void) const
+    {
+      return m_info;
+    }
+
+    int16_t
+    ascent(void) const
+    {
+      return m_info.font_ascent;
+    }
+
+    int16_t
+    descent(void) const
+    {
+      return m_info.font_descent;
+    }
+
+    // nullptr if the font has no such character
+    const xcb_charinfo_t *
+    char_info(uint8_t byte1, uint8_t byte2) const
+    {
+      if (byte1 < m_info.min_byte1 || byte1 > m_info.max_byte1
+          || byte2 < m_info.min_char_or_byte2
+          || byte2 > m_info.max_char_or_byte2) {
+        return nullptr;
+      }
+      // all characters have the same metrics
+      if (m_char_infos.empty()) {
+        return &m_info.min_bounds;
+      }
+      const std::size_t index = (byte1 - m_info.min_byte1) * m_columns
+                              + byte2 - m_info.min_char_or_byte2;
+      if (index >= m_char_infos.size() || ! exists(m_char_infos[index])) {
+        return nullptr;
+      }
+      return &m_char_infos[index];
+    }
+
+    text_extents
+    extents(const xcb_char2b_t * text, std::size_t length) const
+    {
+      return measure(length, [&](std::size_t i)
+                             {
+                               return lookup(text[i].byte1, text[i].byte2);
+                             });
+    }
+
+    text_extents
+    extents(const std::string & text) const
+    {
+      return measure(text.size(), [&](std::size_t i)
+                                  {
+                                    return lookup(0, text[i]);
+                                  });
+    }
+
+    // overall_width of extents(), without the bearings
+    int32_t
+    width(const xcb_char2b_t * text, std::size_t length) const
+    {
+      int32_t width = 0;
+      for (std::size_t i = 0; i < length; ++i) {
+        auto ci = lookup(text[i].byte1, text[i].byte2);
+        width += ci ? ci->character_width : 0;
+      }
+      return width;
+    }
+
+    int32_t
+    width(const std::string & text) const
+    {
+      int32_t width = 0;
+      for (auto ch : text) {
+        auto ci = lookup(0, ch);
+        width += ci ? ci->character_width : 0;
+      }
+      return width;
+    }
+
+  protected:
+    xcb_query_font_reply_t m_info;
+    std::size_t m_columns;
+    std::vector<xcb_charinfo_t> m_char_infos;
+
+    static
+    bool
+    exists(const xcb_charinfo_t & ci)
+    {
+      return ci.character_width != 0 || ci.left_side_bearing != 0
+          || ci.right_side_bearing != 0 || ci.ascent != 0 || ci.descent != 0;
+    }
+
+    const xcb_charinfo_t *
+    lookup(uint8_t byte1, uint8_t byte2) const
+    {
+      auto ci = char_info(byte1, byte2);
+      return ci ? ci : char_info(m_info.default_char >> 8,
+                                 m_info.default_char & 0xff);
+    }
+
+    template<typename Lookup>
+    text_extents
+    measure(std::size_t length, Lookup lookup) const
+    {
+      text_extents e {};
+      e.m_draw_direction = m_info.draw_direction;
+      e.m_font_ascent = m_info.font_ascent;
+      e.m_font_descent = m_info.font_descent;
+
+      bool first = true;
+      for (std::size_t i = 0; i < length; ++i) {
+        auto ci = lookup(i);
+        if (! ci) {
+          continue;
+        }
+        if (first) {
+          e.m_overall_ascent = ci->ascent;
+          e.m_overall_descent = ci->descent;
+          e.m_overall_left = ci->left_side_bearing;
+          e.m_overall_right = ci->right_side_bearing;
+          first = false;
+        } else {
+          e.m_overall_ascent = std::max(e.m_overall_ascent, ci->ascent);
+          e.m_overall_descent = std::max(e.m_overall_descent, ci->descent);
+          e.m_overall_left = std::min(e.m_overall_left,
+              e.m_overall_width + ci->left_side_bearing);
+          e.m_overall_right = std::max(e.m_overall_right,
+              e.m_overall_width + ci->right_side_bearing);
+        }
+        e.m_overall_width += ci->character_width;
+      }
+      return e;
+    }
+}; // class font_metrics
+
+// Queries the metrics of each font once
+template<typename Connection>
+class font_metrics_cache
+{
+  public:
+    template<typename C>
+    explicit
+    font_metrics_cache(C && c)
+      : m_c(std::forward<C>(c))
+    {}
+
+    font_metrics_cache(const font_metrics_cache &) = delete;
+    font_metrics_cache & operator=(const font_metrics_cache &) = delete;
+
+    std::shared_ptr<const font_metrics>
+    get(xcb_fontable_t fontable)
+    {
+      {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto item = m_fonts.find(fontable);
+        if (item != m_fonts.end()) {
+          return item->second;
+        }
+      }
+
+      // no lock during the round trip, a concurrent query is harmless
+      auto metrics = std::make_shared<const font_metrics>(
+          font_metrics::query(m_c, fontable));
+      std::lock_guard<std::mutex> guard(m_mutex);
+      return m_fonts.emplace(fontable, std::move(metrics)).first->second;
+    }
+
+    // Must be called before the id of a closed font is reused, or when the
+    // font of a cached gcontext changes
+    void
+    forget(xcb_fontable_t fontable)
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      m_fonts.erase(fontable);
+    }
+
+    void
+    clear(void)
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      m_fonts.clear();
+    }
+
+  protected:
+    Connection m_c;
+    std::mutex m_mutex;
+    std::unordered_map<xcb_fontable_t,
+                       std::shared_ptr<const font_metrics>> m_fonts;
+}; // class font_metrics_cache
+
+} // namespace xpp
+
+#endif // XPP_FONT_METRICS_HPP
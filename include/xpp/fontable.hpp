@@ -20,6 +20,12 @@ class fontable
     using base::operator=;
 };
 
+// Non-owning handle, copying it does not allocate
+template<typename Connection, template<typename, typename> class ... Interfaces>
+using borrowed_fontable =
+  xpp::generic::borrowed_resource<Connection, xcb_fontable_t,
+                                  xpp::x::fontable, Interfaces ...>;
+
 namespace generic {
 
 template<typename Connection, template<typename, typename> class ... Interfaces>
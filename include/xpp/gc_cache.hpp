@@ -0,0 +1,246 @@
+#ifndef XPP_GC_CACHE_HPP
+#define XPP_GC_CACHE_HPP
+
+#include <list>
+#include <array>
+#include <mutex>
+#include <cstdint>
+#include <unordered_map>
+
+#include "gcontext.hpp"
+
+namespace xpp {
+
+// Shares graphics contexts with the same state. A GC is usable with every
+// drawable of the same screen and depth, hence the state is keyed by the root
+// window of the screen, depth, value mask and values. Cached GCs which are not
+// used anymore are freed least recently used first when there are more than
+// capacity. Shared GCs must not be changed.
+template<typename Connection>
+class gc_cache
+{
+  public:
+    typedef xpp::gcontext<Connection> gcontext_type;
+
+    template<typename C>
+    explicit
+    gc_cache(C && c, std::size_t capacity = 64)
+      : m_c(std::forward<C>(c))
+      , m_capacity(capacity)
+    {}
+
+    gc_cache(const gc_cache &) = delete;
+    gc_cache & operator=(const gc_cache &) = delete;
+
+    // root is the root window of the screen of drawable, value_list is
+    // ordered by bit, like for create_gc
+    gcontext_type
+    get(xcb_drawable_t drawable, xcb_window_t root, uint8_t depth,
+        uint32_t value_mask, const uint32_t * value_list)
+    {
+      const key k(root, depth, value_mask, value_list);
+
+      std::lock_guard<std::mutex> guard(m_mutex);
+      auto item = m_index.find(k);
+      if (item != m_index.end()) {
+        ++m_hits;
+        m_lru.splice(m_lru.begin(), m_lru, item->second);
+        return item->second->second;
+      }
+
+      ++m_misses;
+      m_lru.emplace_front(k, gcontext_type::create(m_c, drawable,
+                                                   value_mask, value_list));
+      m_index.emplace(k, m_lru.begin());
+      // in use from here on, hence not evicted
+      gcontext_type gc = m_lru.front().second;
+      evict();
+      return gc;
+    }
+
+    // One GC per screen and depth, only values which differ from its last
+    // state are sent with ChangeGC. Components which are not in value_mask
+    // keep the value of an earlier call, not the default. The GC stays valid
+    // until the next call for this screen and depth, hence it is meant for
+    // drawing right away.
+    xpp::borrowed_gcontext<Connection>
+    scratch(xcb_drawable_t drawable, xcb_window_t root, uint8_t depth,
+            uint32_t value_mask, const uint32_t * value_list)
+    {
+      const uint64_t scratch_key = uint64_t(root) << 8 | depth;
+
+      std::lock_guard<std::mutex> guard(m_mutex);
+      auto item = m_scratch.find(scratch_key);
+      if (item == m_scratch.end()) {
+        scratch_state s { gcontext_type::create(m_c, drawable,
+                                                value_mask, value_list),
+                          value_mask, {} };
+        for (std::size_t i = 0, n = 0; i < components; ++i) {
+          if (value_mask & (1u << i)) {
+            s.m_values[i] = value_list[n++];
+          }
+        }
+        item = m_scratch.emplace(scratch_key, std::move(s)).first;
+        return xpp::borrowed_gcontext<Connection>(m_c, *item->second.m_gc);
+      }
+
+      scratch_state & s = item->second;
+      uint32_t changed_mask = 0;
+      std::array<uint32_t, components> changed;
+      std::size_t nchanged = 0;
+      for (std::size_t i = 0, n = 0; i < components; ++i) {
+        const uint32_t bit = 1u << i;
+        if (value_mask & bit) {
+          const uint32_t value = value_list[n++];
+          if (! (s.m_known & bit) || s.m_values[i] != value) {
+            changed_mask |= bit;
+            changed[nchanged++] = value;
+            s.m_values[i] = value;
+          }
+        }
+      }
+
+      if (changed_mask != 0) {
+        xpp::x::change_gc(m_c, *s.m_gc, changed_mask, changed.data());
+        s.m_known |= changed_mask;
+        ++m_changes;
+      }
+      return xpp::borrowed_gcontext<Connection>(m_c, *s.m_gc);
+    }
+
+    // Frees cached GCs which are not in use
+    void
+    clear(void)
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      m_scratch.clear();
+      for (auto e = m_lru.begin(); e != m_lru.end(); ) {
+        e = unused(*e) ? erase(e) : std::next(e);
+      }
+    }
+
+    uint64_t
+    hits(void) const
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      return m_hits;
+    }
+
+    uint64_t
+    misses(void) const
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      return m_misses;
+    }
+
+    // ChangeGC requests sent by scratch()
+    uint64_t
+    changes(void) const
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      return m_changes;
+    }
+
+    std::size_t
+    size(void) const
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      return m_lru.size();
+    }
+
+  protected:
+    // XCB_GC_FUNCTION .. XCB_GC_ARC_MODE
+    static const std::size_t components = 23;
+
+    struct key {
+      xcb_window_t m_root;
+      uint8_t m_depth;
+      uint32_t m_mask;
+      std::array<uint32_t, components> m_values;
+
+      key(xcb_window_t root, uint8_t depth, uint32_t mask,
+          const uint32_t * values)
+        : m_root(root), m_depth(depth), m_mask(mask & ((1u << components) - 1))
+      {
+        const std::size_t n = __builtin_popcount(m_mask);
+        std::copy(values, values + n, m_values.begin());
+        std::fill(m_values.begin() + n, m_values.end(), 0);
+      }
+
+      bool
+      operator==(const key & other) const
+      {
+        return m_root == other.m_root && m_depth == other.m_depth
+          && m_mask == other.m_mask && m_values == other.m_values;
+      }
+    };
+
+    struct hash {
+      std::size_t
+      operator()(const key & k) const
+      {
+        // FNV-1a
+        uint64_t h = 14695981039346656037ull;
+        auto mix = [&h](uint32_t v) { h = (h ^ v) * 1099511628211ull; };
+        mix(k.m_root);
+        mix(k.m_depth);
+        mix(k.m_mask);
+        for (std::size_t i = 0, n = __builtin_popcount(k.m_mask); i < n; ++i) {
+          mix(k.m_values[i]);
+        }
+        return h;
+      }
+    };
+
+    struct scratch_state {
+      gcontext_type m_gc;
+      // values which are known to be set on the server
+      uint32_t m_known;
+      std::array<uint32_t, components> m_values;
+    };
+
+    typedef std::list<std::pair<key, gcontext_type>> lru_list;
+
+    Connection m_c;
+    std::size_t m_capacity;
+    mutable std::mutex m_mutex;
+    // most recently used at the front
+    lru_list m_lru;
+    std::unordered_map<key, typename lru_list::iterator, hash> m_index;
+    // by root << 8 | depth
+    std::unordered_map<uint64_t, scratch_state> m_scratch;
+    uint64_t m_hits = 0;
+    uint64_t m_misses = 0;
+    uint64_t m_changes = 0;
+
+    // the cache holds the only reference
+    static
+    bool
+    unused(const std::pair<key, gcontext_type> & e)
+    {
+      return e.second.use_count() == 1;
+    }
+
+    typename lru_list::iterator
+    erase(typename lru_list::iterator e)
+    {
+      m_index.erase(e->first);
+      return m_lru.erase(e);
+    }
+
+    void
+    evict(void)
+    {
+      auto e = m_lru.end();
+      while (m_lru.size() > m_capacity && e != m_lru.begin()) {
+        --e;
+        if (unused(*e)) {
+          e = erase(e);
+        }
+      }
+    }
+}; // class gc_cache
+
+} // namespace xpp
+
+#endif // XPP_GC_CACHE_HPP
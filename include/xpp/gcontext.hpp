@@ -38,10 +38,7 @@ class gcontext
           {
             xpp::x::create_gc(c, gcontext, drawable, value_mask, value_list);
           },
-          [&](const Connection & c, const xcb_gcontext_t & gcontext)
-          {
-            xpp::x::free_gc(c, gcontext);
-          });
+          xpp::generic::free_function { &xcb_free_gc, &xcb_free_gc_checked });
     }
 
     template<typename C>
@@ -57,10 +54,7 @@ class gcontext
             xpp::x::create_gc_checked(c, gcontext, drawable,
                                       value_mask, value_list);
           },
-          [&](const Connection & c, const xcb_gcontext_t & gcontext)
-          {
-            xpp::x::free_gc_checked(c, gcontext);
-          });
+          xpp::generic::free_function { &xcb_free_gc, &xcb_free_gc_checked });
     }
 
     template<typename C>
@@ -74,10 +68,7 @@ class gcontext
           {
             xpp::x::copy_gc(c, src_gc, gcontext, value_mask);
           },
-          [&](const Connection & c, const xcb_gcontext_t & gcontext)
-          {
-            xpp::x::free_gc(c, gcontext);
-          });
+          xpp::generic::free_function { &xcb_free_gc, &xcb_free_gc_checked });
     }
 
 
@@ -92,13 +83,16 @@ class gcontext
           {
             xpp::x::copy_gc_checked(c, src_gc, gcontext, value_mask);
           },
-          [&](const Connection & c, const xcb_gcontext_t & gcontext)
-          {
-            xpp::x::free_gc_checked(c, gcontext);
-          });
+          xpp::generic::free_function { &xcb_free_gc, &xcb_free_gc_checked });
     }
 };
 
+// Non-owning handle, copying it does not allocate
+template<typename Connection, template<typename, typename> class ... Interfaces>
+using borrowed_gcontext =
+  xpp::generic::borrowed_resource<Connection, xcb_gcontext_t,
+                                  xpp::x::gcontext, Interfaces ...>;
+
 namespace generic {
 
 template<typename Connection, template<typename, typename> class ... Interfaces>
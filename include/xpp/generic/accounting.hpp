@@ -0,0 +1,238 @@
+#ifndef XPP_GENERIC_ACCOUNTING_HPP
+#define XPP_GENERIC_ACCOUNTING_HPP
+
+#include <map>
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h> // xcb_extension_t::name
+
+namespace xpp { namespace generic {
+
+// Static description of a request, provided by generated code
+struct request_info {
+  // e.g. "xcb_get_geometry"
+  const char * m_name;
+  // nullptr for core requests
+  xcb_extension_t * m_extension;
+  uint8_t m_opcode;
+  // on the wire, with list data padded to 4 bytes. Lists of serialized
+  // types, e.g. value lists, and the data of requests with a reply are not
+  // included.
+  std::size_t m_size;
+};
+
+// Request data is padded to 4 bytes
+inline
+std::size_t
+padded(std::size_t bytes)
+{
+  return (bytes + 3) & ~std::size_t(3);
+}
+
+struct request_counters {
+  uint64_t m_requests;
+  uint64_t m_request_bytes;
+  uint64_t m_replies;
+  uint64_t m_reply_bytes;
+  uint64_t m_errors;
+};
+
+// Counts requests, replies and errors per extension and opcode of the
+// connections it is given to, see core::account(). Every thread counts into
+// slots of its own, so counting never contends; snapshot() sums them up.
+class accounting
+{
+  public:
+    struct entry {
+      // "xproto" for core requests
+      std::string m_extension;
+      uint8_t m_opcode;
+      std::string m_request;
+      request_counters m_counters;
+    };
+
+    accounting(void)
+      : m_id(next_id())
+    {}
+
+    // Counting is paused while disabled
+    void
+    enable(bool enable = true)
+    {
+      m_enabled.store(enable, std::memory_order_relaxed);
+    }
+
+    bool
+    enabled(void) const
+    {
+      return m_enabled.load(std::memory_order_relaxed);
+    }
+
+    void
+    request(const request_info & info)
+    {
+      if (enabled() && info.m_name) {
+        slot & s = find(info);
+        increment(s.m_requests, 1);
+        increment(s.m_request_bytes, info.m_size);
+      }
+    }
+
+    void
+    reply(const request_info & info, std::size_t bytes)
+    {
+      if (enabled() && info.m_name) {
+        slot & s = find(info);
+        increment(s.m_replies, 1);
+        increment(s.m_reply_bytes, bytes);
+      }
+    }
+
+    void
+    error(const request_info & info)
+    {
+      if (enabled() && info.m_name) {
+        increment(find(info).m_errors, 1);
+      }
+    }
+
+    // Requests which were counted at least once, ordered by extension and
+    // opcode
+    std::vector<entry>
+    snapshot(void) const
+    {
+      std::map<std::pair<std::string, uint8_t>, entry> sum;
+
+      std::lock_guard<std::mutex> guard(m_mutex);
+      for (auto & b : m_blocks) {
+        const std::string extension =
+          b->m_extension ? b->m_extension->name : "xproto";
+
+        for (std::size_t opcode = 0; opcode < b->m_slots.size(); ++opcode) {
+          const slot & s = b->m_slots[opcode];
+          const char * name = s.m_name.load(std::memory_order_acquire);
+          if (! name) {
+            continue;
+          }
+
+          auto & e = sum[std::make_pair(extension, opcode)];
+          e.m_extension = extension;
+          e.m_opcode = opcode;
+          e.m_request = name;
+          e.m_counters.m_requests += load(s.m_requests);
+          e.m_counters.m_request_bytes += load(s.m_request_bytes);
+          e.m_counters.m_replies += load(s.m_replies);
+          e.m_counters.m_reply_bytes += load(s.m_reply_bytes);
+          e.m_counters.m_errors += load(s.m_errors);
+        }
+      }
+
+      std::vector<entry> entries;
+      for (auto & item : sum) {
+        entries.push_back(item.second);
+      }
+      return entries;
+    }
+
+  private:
+    static const std::size_t cache_line = 64;
+
+    // only written by the owning thread
+    struct slot {
+      std::atomic<const char *> m_name { nullptr };
+      std::atomic<uint64_t> m_requests { 0 };
+      std::atomic<uint64_t> m_request_bytes { 0 };
+      std::atomic<uint64_t> m_replies { 0 };
+      std::atomic<uint64_t> m_reply_bytes { 0 };
+      std::atomic<uint64_t> m_errors { 0 };
+      char m_pad[cache_line - 6 * sizeof(uint64_t)];
+    };
+
+    // one per thread and extension
+    struct block {
+      char m_head[cache_line];
+      xcb_extension_t * m_extension = nullptr;
+      std::array<slot, 256> m_slots;
+      char m_tail[cache_line];
+    };
+
+    // blocks of a thread, for all accountings it counted into
+    struct thread_block {
+      uint64_t m_accounting;
+      block * m_block;
+    };
+
+    // unlike the address, never reused by another accounting
+    const uint64_t m_id;
+    std::atomic<bool> m_enabled { true };
+    mutable std::mutex m_mutex;
+    // blocks of exited threads are kept, their counts stay in the sum
+    std::vector<std::unique_ptr<block>> m_blocks;
+
+    static
+    uint64_t
+    next_id(void)
+    {
+      static std::atomic<uint64_t> id { 0 };
+      return ++id;
+    }
+
+    slot &
+    find(const request_info & info)
+    {
+      static thread_local std::vector<thread_block> blocks;
+
+      block * b = nullptr;
+      for (auto & candidate : blocks) {
+        if (candidate.m_accounting == m_id
+            && candidate.m_block->m_extension == info.m_extension) {
+          b = candidate.m_block;
+          break;
+        }
+      }
+
+      if (! b) {
+        std::unique_ptr<block> created(new block);
+        created->m_extension = info.m_extension;
+        b = created.get();
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_blocks.push_back(std::move(created));
+        blocks.push_back(thread_block { m_id, b });
+      }
+
+      slot & s = b->m_slots[info.m_opcode];
+      if (! s.m_name.load(std::memory_order_relaxed)) {
+        s.m_name.store(info.m_name, std::memory_order_release);
+      }
+      return s;
+    }
+
+    // single writer, no need for a locked instruction
+    static
+    void
+    increment(std::atomic<uint64_t> & counter, uint64_t value)
+    {
+      counter.store(counter.load(std::memory_order_relaxed) + value,
+                    std::memory_order_relaxed);
+    }
+
+    static
+    uint64_t
+    load(const std::atomic<uint64_t> & counter)
+    {
+      return counter.load(std::memory_order_relaxed);
+    }
+}; // class accounting
+
+} } // namespace xpp::generic
+
+#endif // XPP_GENERIC_ACCOUNTING_HPP
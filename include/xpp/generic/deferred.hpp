@@ -0,0 +1,112 @@
+#ifndef XPP_GENERIC_DEFERRED_HPP
+#define XPP_GENERIC_DEFERRED_HPP
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+
+#include <xcb/xcb.h>
+
+#include "id_allocator.hpp"
+
+namespace xpp { namespace generic {
+
+typedef xcb_void_cookie_t (*free_request)(xcb_connection_t *, uint32_t);
+
+// The request which frees a resource, e.g.
+// { &xcb_free_pixmap, &xcb_free_pixmap_checked }
+struct free_function {
+  free_request m_unchecked;
+  free_request m_checked;
+};
+
+// Frees which are queued until the connection is flushed, so that dropping
+// many resources at once costs no round trip at all.
+class deferred_free
+{
+  public:
+    void
+    push(const free_function & f, uint32_t xid)
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      m_pending.push_back(entry { f, xid });
+    }
+
+    std::size_t
+    size(void) const
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      return m_pending.size();
+    }
+
+    // Sends all pending frees unchecked, errors are delivered as events.
+    // Freed ids are released to ids, if given.
+    void
+    flush(xcb_connection_t * c, id_allocator * ids = nullptr)
+    {
+      for (auto & e : take()) {
+        e.m_free.m_unchecked(c, e.m_xid);
+        if (ids) {
+          ids->release(e.m_xid);
+        }
+      }
+    }
+
+    // Sends all pending frees, then verifies them with a single round trip,
+    // which also confirms the released ids to ids
+    std::vector<std::shared_ptr<xcb_generic_error_t>>
+    flush_checked(xcb_connection_t * c, id_allocator * ids = nullptr)
+    {
+      std::vector<xcb_void_cookie_t> cookies;
+      for (auto & e : take()) {
+        cookies.push_back(e.m_free.m_checked(c, e.m_xid));
+        if (ids) {
+          ids->release(e.m_xid);
+        }
+      }
+
+      std::vector<std::shared_ptr<xcb_generic_error_t>> errors;
+      if (cookies.empty() && ! ids) {
+        return errors;
+      }
+
+      // once this reply is in, checking the frees does not block and all
+      // frees sent before are processed
+      std::free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), nullptr));
+      if (ids) {
+        ids->confirm();
+      }
+
+      for (auto & cookie : cookies) {
+        xcb_generic_error_t * error = xcb_request_check(c, cookie);
+        if (error) {
+          errors.emplace_back(error, std::free);
+        }
+      }
+      return errors;
+    }
+
+  private:
+    struct entry {
+      free_function m_free;
+      uint32_t m_xid;
+    };
+
+    mutable std::mutex m_mutex;
+    std::vector<entry> m_pending;
+
+    std::vector<entry>
+    take(void)
+    {
+      std::vector<entry> pending;
+      std::lock_guard<std::mutex> guard(m_mutex);
+      pending.swap(m_pending);
+      return pending;
+    }
+}; // class deferred_free
+
+} } // namespace xpp::generic
+
+#endif // XPP_GENERIC_DEFERRED_HPP
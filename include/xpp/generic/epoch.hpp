@@ -0,0 +1,157 @@
+#ifndef XPP_GENERIC_EPOCH_HPP
+#define XPP_GENERIC_EPOCH_HPP
+
+#include <array>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace xpp { namespace generic {
+
+// Epoch based reclamation for objects which readers reach through an atomic
+// pointer. Readers hold a guard while they use what they loaded; writers
+// replace the pointer and retire the old object, which is deleted once no
+// reader can see it anymore. Readers only touch a counter of their own stripe
+// and never wait. Writers must be serialized by the caller; they never wait
+// either, objects which are still in use are deleted by a later retire().
+class epoch
+{
+  public:
+    class guard
+    {
+      public:
+        explicit
+        guard(const epoch & e)
+          : m_readers(e.enter())
+        {}
+
+        guard(const guard &) = delete;
+        guard & operator=(const guard &) = delete;
+
+        ~guard(void)
+        {
+          m_readers->fetch_sub(1, std::memory_order_release);
+        }
+
+      private:
+        std::atomic<uint32_t> * m_readers;
+    }; // class guard
+
+    epoch(void)
+    {}
+
+    epoch(const epoch &) = delete;
+    epoch & operator=(const epoch &) = delete;
+
+    // No reader may be left
+    ~epoch(void)
+    {
+      for (auto & r : m_retired) {
+        r.m_delete(r.m_object);
+      }
+    }
+
+    // Writer only, after the pointer to object has been replaced with a
+    // sequentially consistent store. nullptr is ignored.
+    template<typename T>
+    void
+    retire(const T * object)
+    {
+      if (object) {
+        m_retired.push_back(retired { m_epoch.load(std::memory_order_relaxed),
+                                      object, &destroy<T> });
+      }
+      collect();
+    }
+
+  private:
+    static const std::size_t cache_line = 64;
+    static const std::size_t stripes = 16;
+
+    // readers which entered in an even and an odd epoch
+    struct stripe {
+      std::atomic<uint32_t> m_readers[2];
+      char m_pad[cache_line - 2 * sizeof(uint32_t)];
+    };
+
+    struct retired {
+      uint64_t m_epoch;
+      const void * m_object;
+      void (*m_delete)(const void *);
+    };
+
+    std::atomic<uint64_t> m_epoch { 0 };
+    mutable std::array<stripe, stripes> m_stripes {};
+    // only accessed by the writer
+    std::vector<retired> m_retired;
+
+    template<typename T>
+    static
+    void
+    destroy(const void * object)
+    {
+      delete static_cast<const T *>(object);
+    }
+
+    // The stripe of the calling thread, threads are spread round robin
+    static
+    std::size_t
+    stripe_index(void)
+    {
+      static std::atomic<std::size_t> next { 0 };
+      static thread_local std::size_t index =
+        next.fetch_add(1, std::memory_order_relaxed) % stripes;
+      return index;
+    }
+
+    // The pointer must be loaded after the increment, hence seq_cst: a writer
+    // which replaced it before either sees the increment or the reader sees
+    // the new pointer
+    std::atomic<uint32_t> *
+    enter(void) const
+    {
+      const uint64_t e = m_epoch.load(std::memory_order_seq_cst);
+      auto * readers = &m_stripes[stripe_index()].m_readers[e & 1];
+      readers->fetch_add(1, std::memory_order_seq_cst);
+      return readers;
+    }
+
+    bool
+    idle(uint64_t e) const
+    {
+      for (auto & s : m_stripes) {
+        if (s.m_readers[e & 1].load(std::memory_order_seq_cst) != 0) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    // The epoch advances when the readers of the epoch before have left.
+    // Objects retired in epoch e are unreachable once the epoch is e + 2:
+    // readers which could have loaded them counted themselves in epoch e or
+    // earlier, and both parities were idle since.
+    void
+    collect(void)
+    {
+      uint64_t e = m_epoch.load(std::memory_order_relaxed);
+      for (int i = 0; i < 2 && idle(e + 1); ++i) {
+        m_epoch.store(++e, std::memory_order_seq_cst);
+      }
+
+      std::size_t kept = 0;
+      for (auto & r : m_retired) {
+        if (r.m_epoch + 2 <= e) {
+          r.m_delete(r.m_object);
+        } else {
+          m_retired[kept++] = r;
+        }
+      }
+      m_retired.resize(kept);
+    }
+}; // class epoch
+
+} } // namespace xpp::generic
+
+#endif // XPP_GENERIC_EPOCH_HPP
@@ -1,35 +1,299 @@
 #ifndef XPP_GENERIC_EVENT_HPP
 #define XPP_GENERIC_EVENT_HPP
 
+#include <mutex> // lock_guard
+#include <atomic>
 #include <memory> // shared_ptr
+#include <cstdlib> // free
+#include <utility> // swap
+#include <functional>
 #include <xcb/xcb.h> // xcb_generic_event_t
 
 namespace xpp { namespace generic {
 
+class event_pool;
+
+namespace detail {
+
+struct event_node {
+  std::atomic<unsigned int> m_count;
+  xcb_generic_event_t * m_event;
+  // nullptr if this node is not recycled through a pool
+  event_pool * m_pool;
+  event_node * m_next;
+  // when the event was read, see xpp::event::statistics
+  uint64_t m_time;
+};
+
+} // namespace detail
+
+// Reference counted handle for an event returned by libxcb.
+// The reference count lives in a node which is recycled through the
+// event_pool of the connection. The pool stays alive as long as handles made
+// from it, which may therefore outlive their connection.
+class event_ptr
+{
+  public:
+    event_ptr(void)
+    {}
+
+    event_ptr(std::nullptr_t)
+    {}
+
+    // Takes ownership of a malloc()'ed event
+    explicit
+    event_ptr(xcb_generic_event_t * event)
+      : m_node(event ? new detail::event_node { {1}, event, nullptr, nullptr, 0 }
+                     : nullptr)
+    {}
+
+    event_ptr(const event_ptr & other)
+      : m_node(other.m_node)
+    {
+      if (m_node) {
+        m_node->m_count.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    event_ptr(event_ptr && other)
+      : m_node(other.m_node)
+    {
+      other.m_node = nullptr;
+    }
+
+    ~event_ptr(void)
+    {
+      release();
+    }
+
+    event_ptr &
+    operator=(event_ptr other)
+    {
+      std::swap(m_node, other.m_node);
+      return *this;
+    }
+
+    xcb_generic_event_t *
+    get(void) const
+    {
+      return m_node ? m_node->m_event : nullptr;
+    }
+
+    xcb_generic_event_t &
+    operator*(void) const
+    {
+      return *m_node->m_event;
+    }
+
+    xcb_generic_event_t *
+    operator->(void) const
+    {
+      return m_node->m_event;
+    }
+
+    explicit
+    operator bool(void) const
+    {
+      return m_node != nullptr;
+    }
+
+    // The returned shared_ptr holds a reference on this event
+    operator std::shared_ptr<xcb_generic_event_t>(void) const
+    {
+      if (! m_node) {
+        return nullptr;
+      }
+
+      event_ptr reference(*this);
+      return std::shared_ptr<xcb_generic_event_t>(
+          get(), [reference](xcb_generic_event_t *) {});
+    }
+
+    // 0 unless set by the pool it was made from
+    uint64_t
+    time(void) const
+    {
+      return m_node ? m_node->m_time : 0;
+    }
+
+    unsigned int
+    use_count(void) const
+    {
+      return m_node ? m_node->m_count.load(std::memory_order_relaxed) : 0;
+    }
+
+    void
+    reset(void)
+    {
+      release();
+      m_node = nullptr;
+    }
+
+  private:
+    friend class event_pool;
+
+    detail::event_node * m_node = nullptr;
+
+    explicit
+    event_ptr(detail::event_node * node)
+      : m_node(node)
+    {}
+
+    inline void release(void);
+}; // class event_ptr
+
+// Free list for event_ptr nodes. Once warmed up, wrapping an event does not
+// allocate. Nodes may be released from any thread. The pool is freed when the
+// pointer returned by create() and all events made from it are released.
+class event_pool
+{
+  public:
+    static
+    std::shared_ptr<event_pool>
+    create(void)
+    {
+      return std::shared_ptr<event_pool>(new event_pool(),
+                                         [](event_pool * p) { p->unref(); });
+    }
+
+    event_pool(const event_pool &) = delete;
+    event_pool & operator=(const event_pool &) = delete;
+
+    // f is called with the time of each event made with a time != 0, when
+    // its last handle is released. May be called from any thread.
+    void
+    on_release(const std::function<void(uint64_t)> & f)
+    {
+      std::atomic_store(&m_on_release, f ? std::make_shared<
+          const std::function<void(uint64_t)>>(f) : nullptr);
+    }
+
+    // Takes ownership of a malloc()'ed event, returns an empty handle for
+    // nullptr
+    event_ptr
+    make(xcb_generic_event_t * event, uint64_t time = 0)
+    {
+      if (! event) {
+        return event_ptr();
+      }
+
+      detail::event_node * node = nullptr;
+
+      {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (! m_free) {
+          m_free = m_recycled.exchange(nullptr, std::memory_order_acquire);
+        }
+        if (m_free) {
+          node = m_free;
+          m_free = m_free->m_next;
+        }
+      }
+
+      m_refs.fetch_add(1, std::memory_order_relaxed);
+      if (node) {
+        node->m_count.store(1, std::memory_order_relaxed);
+        node->m_event = event;
+        node->m_time = time;
+      } else {
+        node = new detail::event_node { {1}, event, this, nullptr, time };
+      }
+
+      return event_ptr(node);
+    }
+
+  private:
+    friend class event_ptr;
+
+    // one for the owner and one per node in use
+    std::atomic<std::size_t> m_refs { 1 };
+    std::mutex m_mutex;
+    // only accessed with m_mutex held
+    detail::event_node * m_free = nullptr;
+    // lock-free stack, nodes are only ever pushed or taken all at once
+    std::atomic<detail::event_node *> m_recycled { nullptr };
+    // accessed with std::atomic_load() and atomic_store()
+    std::shared_ptr<const std::function<void(uint64_t)>> m_on_release;
+
+    event_pool(void)
+    {}
+
+    ~event_pool(void)
+    {
+      destroy(m_free);
+      destroy(m_recycled.exchange(nullptr));
+    }
+
+    void
+    unref(void)
+    {
+      if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete this;
+      }
+    }
+
+    void
+    recycle(detail::event_node * node)
+    {
+      if (node->m_time != 0) {
+        auto f = std::atomic_load(&m_on_release);
+        if (f) {
+          (*f)(node->m_time);
+        }
+      }
+
+      node->m_next = m_recycled.load(std::memory_order_relaxed);
+      while (! m_recycled.compare_exchange_weak(node->m_next, node,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed))
+      {}
+      unref();
+    }
+
+    static
+    void
+    destroy(detail::event_node * node)
+    {
+      while (node) {
+        auto next = node->m_next;
+        delete node;
+        node = next;
+      }
+    }
+}; // class event_pool
+
+void
+event_ptr::release(void)
+{
+  if (m_node && m_node->m_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    std::free(m_node->m_event);
+    m_node->m_event = nullptr;
+    if (m_node->m_pool) {
+      m_node->m_pool->recycle(m_node);
+    } else {
+      delete m_node;
+    }
+  }
+}
+
 template<typename Event>
 class event {
   public:
-    event(const std::shared_ptr<xcb_generic_event_t> & event)
+    event(const event_ptr & event)
       : m_event(event)
     {}
 
-    virtual
-    ~event(void) {}
-
-    virtual
     operator const Event &(void) const
     {
       return reinterpret_cast<const Event &>(*m_event);
     }
 
-    virtual
     const Event &
     operator*(void) const
     {
       return reinterpret_cast<const Event &>(*m_event);
     }
 
-    virtual
     Event *
     operator->(void) const
     {
@@ -37,7 +301,7 @@ class event {
     }
 
   protected:
-    std::shared_ptr<xcb_generic_event_t> m_event;
+    event_ptr m_event;
 }; // class event
 
 } } // namespace xpp::generic
@@ -2,7 +2,11 @@
 #define XPP_GENERIC_EXTENSION_HPP
 
 // #include <iostream>
+#include <atomic>
 #include <xcb/xcb.h>
+#include <xcb/xcbext.h> // xcb_extension_t::name
+
+#include "profiler.hpp"
 
 namespace xpp { namespace generic {
 
@@ -16,27 +20,62 @@ class extension
       prefetch();
     }
 
+    // Without a connection, e.g. for data of a recorded session
+    explicit
+    extension(const xcb_query_extension_reply_t * reply)
+      : m_extension(reply)
+    {}
+
+    extension(const extension & other)
+      : m_c(other.m_c)
+      , m_extension(other.m_extension.load(std::memory_order_acquire))
+    {}
+
+    extension &
+    operator=(const extension & other)
+    {
+      m_c = other.m_c;
+      m_extension.store(other.m_extension.load(std::memory_order_acquire),
+                        std::memory_order_release);
+      return *this;
+    }
+
+    // The data is read on first access, if get() was not called before
     const xcb_query_extension_reply_t &
     operator*(void) const
     {
-      return *m_extension;
+      return *data();
     }
 
     const xcb_query_extension_reply_t *
     operator->(void) const
     {
-      return m_extension;
+      return data();
     }
 
     operator const xcb_query_extension_reply_t *(void) const
     {
-      return m_extension;
+      return data();
+    }
+
+    // Whether the data was read already
+    bool
+    resolved(void) const
+    {
+      return m_extension.load(std::memory_order_acquire) != nullptr;
+    }
+
+    static
+    xcb_extension_t *
+    id(void)
+    {
+      return Id;
     }
 
     Derived &
     get(void)
     {
-      m_extension = xcb_get_extension_data(m_c, Id);
+      data();
       return static_cast<Derived &>(*this);
     }
 
@@ -47,11 +86,28 @@ class extension
       return static_cast<Derived &>(*this);
     }
 
-  private:
+  protected:
     xcb_connection_t * m_c = nullptr;
+
+  private:
     // The result must not be freed.
     // This storage is managed by the cache itself.
-    const xcb_query_extension_reply_t * m_extension = nullptr;
+    mutable std::atomic<const xcb_query_extension_reply_t *> m_extension { nullptr };
+
+    // xcb caches the data, hence threads which read it at the same time get
+    // the same pointer and no once flag is needed
+    const xcb_query_extension_reply_t *
+    data(void) const
+    {
+      const xcb_query_extension_reply_t * data =
+        m_extension.load(std::memory_order_acquire);
+      if (! data && m_c) {
+        blocking_call call("extension", Id->name);
+        data = xcb_get_extension_data(m_c, Id);
+        m_extension.store(data, std::memory_order_release);
+      }
+      return data;
+    }
 }; // class extension
 
 } } // namespace xpp::generic
@@ -0,0 +1,27 @@
+#ifndef XPP_GENERIC_FLUSH_POLICY_HPP
+#define XPP_GENERIC_FLUSH_POLICY_HPP
+
+#include <xcb/xcb.h>
+
+#include "accounting.hpp"
+
+namespace xpp { namespace generic {
+
+// Decides when a connection is flushed, see xpp::flush_scheduler
+class flush_policy {
+  public:
+    virtual ~flush_policy(void) {}
+
+    // The connection this policy is bound to, nullptr for any
+    virtual xcb_connection_t * connection(void) const { return nullptr; }
+
+    // request has been sent on c
+    virtual void sent(xcb_connection_t * c, const request_info & request) = 0;
+
+    // Flushes c now, e.g. for core::flush()
+    virtual int flush(xcb_connection_t * c) = 0;
+};
+
+} } // namespace xpp::generic
+
+#endif // XPP_GENERIC_FLUSH_POLICY_HPP
@@ -0,0 +1,148 @@
+#ifndef XPP_GENERIC_HISTOGRAM_HPP
+#define XPP_GENERIC_HISTOGRAM_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace xpp { namespace generic {
+
+// Log-linear histogram in the style of HdrHistogram: every power of two is
+// split into 16 buckets, hence values are recorded with a relative error of
+// at most 1/16. Recording is lock-free and may happen from any thread,
+// reading while recording gives a slightly inconsistent but usable sample.
+class histogram
+{
+  public:
+    histogram(void)
+    {
+      reset();
+    }
+
+    histogram(const histogram &) = delete;
+    histogram & operator=(const histogram &) = delete;
+
+    void
+    record(uint64_t value)
+    {
+      m_counts[index(value)].fetch_add(1, std::memory_order_relaxed);
+      m_count.fetch_add(1, std::memory_order_relaxed);
+      m_sum.fetch_add(value, std::memory_order_relaxed);
+
+      uint64_t max = m_max.load(std::memory_order_relaxed);
+      while (value > max
+             && ! m_max.compare_exchange_weak(max, value,
+                                              std::memory_order_relaxed))
+      {}
+    }
+
+    uint64_t
+    count(void) const
+    {
+      return m_count.load(std::memory_order_relaxed);
+    }
+
+    uint64_t
+    max(void) const
+    {
+      return m_max.load(std::memory_order_relaxed);
+    }
+
+    double
+    mean(void) const
+    {
+      const uint64_t n = count();
+      return n == 0 ? 0.0 : static_cast<double>(
+          m_sum.load(std::memory_order_relaxed)) / n;
+    }
+
+    // Upper bound of the bucket holding the q-th quantile, 0 <= q <= 1
+    uint64_t
+    percentile(double q) const
+    {
+      const uint64_t n = count();
+      if (n == 0) {
+        return 0;
+      }
+
+      const uint64_t rank = q >= 1.0 ? n : static_cast<uint64_t>(q * n) + 1;
+      uint64_t seen = 0;
+      for (std::size_t i = 0; i < buckets; ++i) {
+        seen += m_counts[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+          const uint64_t upper = highest(i);
+          return upper < max() ? upper : max();
+        }
+      }
+      return max();
+    }
+
+    // Number of values in [lowest(i), highest(i)]
+    uint64_t
+    bucket(std::size_t i) const
+    {
+      return m_counts[i].load(std::memory_order_relaxed);
+    }
+
+    void
+    reset(void)
+    {
+      for (auto & c : m_counts) {
+        c.store(0, std::memory_order_relaxed);
+      }
+      m_count.store(0, std::memory_order_relaxed);
+      m_sum.store(0, std::memory_order_relaxed);
+      m_max.store(0, std::memory_order_relaxed);
+    }
+
+    static const unsigned int sub_bucket_bits = 4;
+    static const uint64_t sub_buckets = 1u << sub_bucket_bits;
+    static const std::size_t buckets = (64 - sub_bucket_bits + 1) * sub_buckets;
+
+    static
+    std::size_t
+    index(uint64_t value)
+    {
+      if (value < sub_buckets) {
+        return value;
+      }
+
+      const unsigned int msb = 63 - __builtin_clzll(value);
+      const unsigned int shift = msb - sub_bucket_bits;
+      return (shift + 1) * sub_buckets + (value >> shift) - sub_buckets;
+    }
+
+    static
+    uint64_t
+    lowest(std::size_t index)
+    {
+      if (index < sub_buckets) {
+        return index;
+      }
+
+      const unsigned int shift = index / sub_buckets - 1;
+      return (sub_buckets + index % sub_buckets) << shift;
+    }
+
+    static
+    uint64_t
+    highest(std::size_t index)
+    {
+      if (index < sub_buckets) {
+        return index;
+      }
+
+      const unsigned int shift = index / sub_buckets - 1;
+      return lowest(index) + ((uint64_t(1) << shift) - 1);
+    }
+
+  private:
+    std::array<std::atomic<uint64_t>, buckets> m_counts;
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_sum;
+    std::atomic<uint64_t> m_max;
+}; // class histogram
+
+} } // namespace xpp::generic
+
+#endif // XPP_GENERIC_HISTOGRAM_HPP
@@ -0,0 +1,25 @@
+#ifndef XPP_GENERIC_ID_ALLOCATOR_HPP
+#define XPP_GENERIC_ID_ALLOCATOR_HPP
+
+#include <cstdint>
+
+namespace xpp { namespace generic {
+
+// Source of resource ids for a connection, see xpp::xid_allocator
+class id_allocator {
+  public:
+    virtual ~id_allocator(void) {}
+
+    virtual uint32_t generate(void) = 0;
+
+    // A request freeing xid has been sent
+    virtual void release(uint32_t xid) = 0;
+
+    // The server has processed every request sent so far, released ids may
+    // be reused
+    virtual void confirm(void) = 0;
+};
+
+} } // namespace xpp::generic
+
+#endif // XPP_GENERIC_ID_ALLOCATOR_HPP
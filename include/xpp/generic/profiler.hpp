@@ -0,0 +1,185 @@
+#ifndef XPP_GENERIC_PROFILER_HPP
+#define XPP_GENERIC_PROFILER_HPP
+
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <execinfo.h> // backtrace
+
+namespace xpp { namespace generic {
+
+// Records where the application blocks on the X server: replies, checked
+// requests, waiting for events and extension queries. Disabled by default,
+// then the cost of a blocking call is one relaxed load.
+class profiler
+{
+  public:
+    struct site {
+      // "reply", "check", "request_check", "wait_for_event", "extension",
+      // "flush_checked"
+      const char * m_operation;
+      // e.g. "xcb_get_geometry", empty if unknown
+      std::string m_request;
+      // return addresses, innermost first, resolve with addr2line. The first
+      // frames are in xpp, how many depends on inlining; the call site is the
+      // first frame outside of the xpp headers.
+      std::vector<const void *> m_stack;
+      // estimated from the samples
+      uint64_t m_calls;
+      uint64_t m_nanoseconds;
+    };
+
+    static
+    profiler &
+    instance(void)
+    {
+      static profiler p;
+      return p;
+    }
+
+    // Profiles every n-th blocking call of each thread, 0 disables. Call
+    // sites are told apart by the return addresses of the innermost frames.
+    void
+    enable(unsigned int every = 1, unsigned int frames = 8)
+    {
+      m_frames.store(frames == 0 ? 1 : frames < max_frames ? frames : max_frames,
+                     std::memory_order_relaxed);
+      m_every.store(every, std::memory_order_relaxed);
+    }
+
+    void
+    disable(void)
+    {
+      enable(0);
+    }
+
+    unsigned int
+    frames(void) const
+    {
+      return m_frames.load(std::memory_order_relaxed);
+    }
+
+    bool
+    sample(void) const
+    {
+      const unsigned int every = m_every.load(std::memory_order_relaxed);
+      if (every == 0) {
+        return false;
+      }
+
+      static thread_local unsigned int n = 0;
+      return ++n % every == 0;
+    }
+
+    void
+    record(const char * operation, const char * request,
+           std::vector<const void *> stack, uint64_t nanoseconds)
+    {
+      const uint64_t every = std::max(1u, m_every.load(std::memory_order_relaxed));
+      std::lock_guard<std::mutex> guard(m_mutex);
+      auto & site = m_sites[key(operation, request ? request : "",
+                                std::move(stack))];
+      site.first += every;
+      site.second += every * nanoseconds;
+    }
+
+    // Call sites ordered by the number of round trips, then by time blocked
+    std::vector<site>
+    report(void) const
+    {
+      std::vector<site> sites;
+      {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        for (auto & item : m_sites) {
+          sites.push_back(site { std::get<0>(item.first),
+                                 std::get<1>(item.first),
+                                 std::get<2>(item.first),
+                                 item.second.first,
+                                 item.second.second });
+        }
+      }
+
+      std::sort(sites.begin(), sites.end(),
+          [](const site & a, const site & b)
+          {
+            return a.m_calls != b.m_calls ? a.m_calls > b.m_calls
+                                          : a.m_nanoseconds > b.m_nanoseconds;
+          });
+      return sites;
+    }
+
+    void
+    reset(void)
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      m_sites.clear();
+    }
+
+    static const unsigned int max_frames = 32;
+
+  private:
+    typedef std::tuple<const char *, std::string, std::vector<const void *>> key;
+
+    std::atomic<unsigned int> m_every { 0 };
+    std::atomic<unsigned int> m_frames { 8 };
+    mutable std::mutex m_mutex;
+    // calls, nanoseconds
+    std::map<key, std::pair<uint64_t, uint64_t>> m_sites;
+
+    profiler(void)
+    {}
+}; // class profiler
+
+// Profiles the enclosing scope as one blocking call
+class blocking_call
+{
+  public:
+    explicit
+    blocking_call(const char * operation, const char * request = nullptr)
+    {
+      if (profiler::instance().sample()) {
+        m_operation = operation;
+        m_request = request;
+        unwind();
+        m_start = std::chrono::steady_clock::now();
+      }
+    }
+
+    blocking_call(const blocking_call &) = delete;
+    blocking_call & operator=(const blocking_call &) = delete;
+
+    ~blocking_call(void)
+    {
+      if (m_operation) {
+        profiler::instance().record(m_operation, m_request, std::move(m_stack),
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::steady_clock::now() - m_start).count());
+      }
+    }
+
+  private:
+    const char * m_operation = nullptr;
+    const char * m_request = nullptr;
+    std::vector<const void *> m_stack;
+    std::chrono::steady_clock::time_point m_start;
+
+    // Not inlined, so that its own frame is the one to skip
+    __attribute__((noinline))
+    void
+    unwind(void)
+    {
+      void * frames[profiler::max_frames + 1];
+      const int n = backtrace(frames, profiler::instance().frames() + 1);
+      m_stack.assign(frames + std::min(n, 1), frames + n);
+    }
+}; // class blocking_call
+
+} } // namespace xpp::generic
+
+#endif // XPP_GENERIC_PROFILER_HPP
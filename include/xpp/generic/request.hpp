@@ -3,9 +3,12 @@
 
 #include <array>
 #include <memory>
+#include <tuple> // generated request sizes
 #include <cstdlib>
 #include <xcb/xcb.h>
 #include "error.hpp"
+#include "profiler.hpp"
+#include "accounting.hpp"
 #include "signature.hpp"
 
 #define REPLY_TEMPLATE \
@@ -28,13 +31,65 @@
 
 namespace xpp { namespace generic {
 
+namespace detail {
+
+// e.g. core::request_sent(), which hands the request to its flush policy
+template<typename Connection>
+auto
+request_sent(Connection && c, const request_info & request, int)
+  -> decltype(c.request_sent(request), void())
+{
+  c.request_sent(request);
+}
+
+template<typename Connection>
+void
+request_sent(Connection &&, const request_info &, long)
+{}
+
+// e.g. core::accounting(), nullptr if the connection is not accounted
+template<typename Connection>
+auto
+accounting_of(Connection && c, int) -> decltype(c.accounting())
+{
+  return c.accounting();
+}
+
+template<typename Connection>
+xpp::generic::accounting *
+accounting_of(Connection &&, long)
+{
+  return nullptr;
+}
+
+} // namespace detail
+
+// Called by generated requests after request has been sent on c
+template<typename Connection>
+void
+sent(Connection && c, const request_info & request)
+{
+  if (auto * a = detail::accounting_of(c, 0)) {
+    a->request(request);
+  }
+  detail::request_sent(c, request, 0);
+}
+
+// request is used by xpp::generic::profiler and xpp::generic::accounting
 template<typename Connection, typename Dispatcher>
 void
-check(Connection && c, const xcb_void_cookie_t & cookie)
+check(Connection && c, const xcb_void_cookie_t & cookie,
+      const request_info & request = request_info())
 {
-  xcb_generic_error_t * error =
-    xcb_request_check(std::forward<Connection>(c), cookie);
+  xcb_generic_error_t * error = nullptr;
+  {
+    blocking_call call("check", request.m_name);
+    error = xcb_request_check(std::forward<Connection>(c), cookie);
+  }
   if (error) {
+    if (auto * a = detail::accounting_of(c, 0)) {
+      a->error(request);
+    }
     dispatch(std::forward<Connection>(c),
              std::shared_ptr<xcb_generic_error_t>(error, std::free));
   }
@@ -43,6 +98,25 @@ check(Connection && c, const xcb_void_cookie_t & cookie)
 struct checked_tag {};
 struct unchecked_tag {};
 
+namespace detail {
+
+// Generated replies describe their request
+template<typename Reply>
+auto
+request_info(int) -> decltype(Reply::request_info())
+{
+  return Reply::request_info();
+}
+
+template<typename Reply>
+xpp::generic::request_info
+request_info(long)
+{
+  return xpp::generic::request_info();
+}
+
+} // namespace detail
+
 template<typename ... Types>
 class reply;
 
@@ -63,7 +137,9 @@ class reply<Derived,
       : m_c(std::forward<C>(c))
       , m_cookie(Derived::cookie(std::forward<C>(c),
                                  std::forward<Parameter>(parameter) ...))
-    {}
+    {
+      sent(m_c, detail::request_info<Derived>(0));
+    }
 
     operator bool(void)
     {
@@ -86,7 +162,17 @@ class reply<Derived,
     get(void)
     {
       if (! m_reply) {
-        m_reply = get(Check());
+        const xpp::generic::request_info request =
+          detail::request_info<Derived>(0);
+        {
+          blocking_call call("reply", request.m_name);
+          m_reply = get(Check(), request);
+        }
+        auto * a = detail::accounting_of(m_c, 0);
+        if (m_reply && a) {
+          // replies are 32 bytes plus length 4 byte units
+          a->reply(request, 32 + 4 * m_reply->length);
+        }
       }
       return m_reply;
     }
@@ -105,19 +191,23 @@ class reply<Derived,
     std::shared_ptr<Reply> m_reply;
 
     std::shared_ptr<Reply>
-    get(checked_tag)
+    get(checked_tag, const xpp::generic::request_info & request)
     {
       xcb_generic_error_t * error = nullptr;
       auto reply = std::shared_ptr<Reply>(ReplyFunction(m_c, m_cookie, &error),
                                           std::free);
       if (error) {
+        if (auto * a = detail::accounting_of(m_c, 0)) {
+          a->error(request);
+        }
         dispatch(m_c, std::shared_ptr<xcb_generic_error_t>(error, std::free));
       }
       return reply;
     }
 
     std::shared_ptr<Reply>
-    get(unchecked_tag)
+    // errors end up in the event queue and are not accounted
+    get(unchecked_tag, const xpp::generic::request_info &)
     {
       return std::shared_ptr<Reply>(ReplyFunction(m_c, m_cookie, nullptr),
                                     std::free);
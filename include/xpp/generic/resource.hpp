@@ -3,6 +3,8 @@
 
 #include <iostream> // std::{hex,dec}
 #include <memory> // std::shared_ptr
+#include <utility> // std::declval
+#include "deferred.hpp"
 #include "iterator_traits.hpp"
 
 #include <xcb/xcb.h> // xcb_generate_id
@@ -33,6 +35,115 @@ class interfaces
     }
 }; // class interfaces
 
+// Connections may have their own id allocation, see xpp::xid_allocator
+template<typename Connection>
+auto
+generate_id(Connection && c, int) -> decltype(c.generate_id())
+{
+  return c.generate_id();
+}
+
+template<typename Connection>
+uint32_t
+generate_id(Connection && c, long)
+{
+  return xcb_generate_id(c);
+}
+
+// Connections may defer the free or release the id, see core::free_resource()
+template<typename Connection>
+auto
+release(Connection && c, const free_function & f, uint32_t xid, int)
+  -> decltype(c.free_resource(f, xid), void())
+{
+  c.free_resource(f, xid);
+}
+
+template<typename Connection>
+void
+release(Connection && c, const free_function & f, uint32_t xid, long)
+{
+  f.m_unchecked(c, xid);
+}
+
+template<typename Connection, typename ResourceId>
+class free_deleter
+{
+  public:
+    free_deleter(Connection c, const free_function & f)
+      : m_c(c), m_free(f)
+    {}
+
+    void
+    operator()(ResourceId * r)
+    {
+      release(m_c, m_free, *r, 0);
+      delete r;
+    }
+
+  private:
+    Connection m_c;
+    free_function m_free;
+}; // class free_deleter
+
+template<typename Connection, typename ResourceId, typename Destroy>
+class destroy_deleter
+{
+  public:
+    destroy_deleter(Connection c, Destroy destroy)
+      : m_c(c), m_destroy(destroy)
+    {}
+
+    void
+    operator()(ResourceId * r)
+    {
+      m_destroy(m_c, *r);
+      delete r;
+    }
+
+  private:
+    Connection m_c;
+    Destroy m_destroy;
+}; // class destroy_deleter
+
+// Keeps a Connection which is a reference as a pointer, so that handles stay
+// assignable
+template<typename Connection>
+class connection_holder
+{
+  public:
+    connection_holder(Connection c)
+      : m_c(c)
+    {}
+
+    Connection
+    get(void) const
+    {
+      return m_c;
+    }
+
+  private:
+    Connection m_c;
+}; // class connection_holder
+
+template<typename Connection>
+class connection_holder<Connection &>
+{
+  public:
+    connection_holder(Connection & c)
+      : m_c(&c)
+    {}
+
+    Connection &
+    get(void) const
+    {
+      return *m_c;
+    }
+
+  private:
+    Connection * m_c;
+}; // class connection_holder
+
 }
 
 template<typename Connection, typename ResourceId,
@@ -53,6 +164,9 @@ class resource
       : m_c(c)
     {}
 
+    // destroy is either a free_function, which is deferred if the connection
+    // is set up for it, or a callable which is called with the connection and the
+    // resource id when the last reference is dropped
     template<typename C, typename Create, typename Destroy>
     static
     self
@@ -60,7 +174,7 @@ class resource
     {
       self resource(std::forward<C>(c));
 
-      auto xid = xcb_generate_id(std::forward<C>(c));
+      auto xid = detail::generate_id(c, 0);
 
       // class create before instatiating the shared_ptr
       // create might fail and throw an error, hence shared_ptr would hold an
@@ -68,17 +182,28 @@ class resource
       // when create() throws, then the shared_ptr will not be created
       create(std::forward<C>(c), xid);
 
-      resource.m_resource =
-        std::shared_ptr<ResourceId>(new ResourceId(xid),
-          [&](ResourceId * r)
-          {
-            destroy(resource.m_c, *r);
-            delete r;
-          });
+      resource.m_resource = own(resource.m_c, xid, destroy);
 
       return resource;
     }
 
+    static
+    std::shared_ptr<ResourceId>
+    own(Connection c, const ResourceId & xid, const free_function & f)
+    {
+      return std::shared_ptr<ResourceId>(new ResourceId(xid),
+          detail::free_deleter<Connection, ResourceId>(c, f));
+    }
+
+    template<typename Destroy>
+    static
+    std::shared_ptr<ResourceId>
+    own(Connection c, const ResourceId & xid, Destroy destroy)
+    {
+      return std::shared_ptr<ResourceId>(new ResourceId(xid),
+          detail::destroy_deleter<Connection, ResourceId, Destroy>(c, destroy));
+    }
+
   public:
     template<typename C>
     resource(C && c, const ResourceId & resource_id)
@@ -124,8 +249,184 @@ class resource
     {
       return m_c;
     }
+
+    // Number of handles sharing this resource
+    long
+    use_count(void) const
+    {
+      return m_resource.use_count();
+    }
 }; // class resource
 
+// Non-owning handle: just the id and the connection, no allocation.
+// Trivially copyable if Connection is a reference or a pointer.
+template<typename Connection, typename ResourceId,
+         template<typename, typename> class ... Interfaces>
+class borrowed_resource
+  : public detail::interfaces<Connection,
+                              borrowed_resource<Connection, ResourceId, Interfaces ...>,
+                              ResourceId, Interfaces ...>
+{
+  public:
+    template<typename C>
+    borrowed_resource(C && c, const ResourceId & resource_id)
+      : m_c(std::forward<C>(c))
+      , m_resource(resource_id)
+    {}
+
+    // Borrows from an owning handle, which has to outlive this one
+    template<typename Handle,
+             typename = decltype(std::declval<const Handle &>().connection())>
+    borrowed_resource(const Handle & handle)
+      : m_c(handle.connection())
+      , m_resource(*handle)
+    {}
+
+    const ResourceId &
+    operator*(void) const
+    {
+      return m_resource;
+    }
+
+    operator const ResourceId &(void) const
+    {
+      return m_resource;
+    }
+
+    Connection
+    connection(void) const
+    {
+      return m_c.get();
+    }
+
+  private:
+    detail::connection_holder<Connection> m_c;
+    ResourceId m_resource;
+}; // class borrowed_resource
+
+// Move-only owning handle, frees the resource when it goes out of scope
+template<typename Connection, typename ResourceId,
+         template<typename, typename> class ... Interfaces>
+class unique_resource
+  : public detail::interfaces<Connection,
+                              unique_resource<Connection, ResourceId, Interfaces ...>,
+                              ResourceId, Interfaces ...>
+{
+  public:
+    using self = unique_resource<Connection, ResourceId, Interfaces ...>;
+
+    template<typename C, typename Create>
+    static
+    self
+    make(C && c, Create create, const free_function & f)
+    {
+      auto xid = detail::generate_id(c, 0);
+      // nothing is owned if create() throws
+      create(std::forward<C>(c), xid);
+      return self(std::forward<C>(c), xid, f);
+    }
+
+    // Takes ownership of resource_id
+    template<typename C>
+    unique_resource(C && c, const ResourceId & resource_id,
+                    const free_function & f)
+      : m_c(std::forward<C>(c))
+      , m_resource(resource_id)
+      , m_free(f)
+    {}
+
+    unique_resource(unique_resource && other)
+      : m_c(other.m_c)
+      , m_resource(other.m_resource)
+      , m_free(other.m_free)
+    {
+      other.m_free = free_function { nullptr, nullptr };
+    }
+
+    unique_resource &
+    operator=(unique_resource && other)
+    {
+      if (this != &other) {
+        reset();
+        m_c = other.m_c;
+        m_resource = other.m_resource;
+        m_free = other.m_free;
+        other.m_free = free_function { nullptr, nullptr };
+      }
+      return *this;
+    }
+
+    unique_resource(const unique_resource &) = delete;
+    unique_resource & operator=(const unique_resource &) = delete;
+
+    ~unique_resource(void)
+    {
+      reset();
+    }
+
+    // Frees the resource now, deferred if the connection is set up for it
+    void
+    reset(void)
+    {
+      if (m_free.m_unchecked) {
+        detail::release(m_c.get(), m_free, m_resource, 0);
+        m_free = free_function { nullptr, nullptr };
+      }
+    }
+
+    // Gives up ownership without freeing the resource
+    ResourceId
+    release(void)
+    {
+      m_free = free_function { nullptr, nullptr };
+      return m_resource;
+    }
+
+    borrowed_resource<Connection, ResourceId, Interfaces ...>
+    borrow(void) const
+    {
+      return borrowed_resource<Connection, ResourceId, Interfaces ...>(
+          m_c.get(), m_resource);
+    }
+
+    const ResourceId &
+    operator*(void) const
+    {
+      return m_resource;
+    }
+
+    operator const ResourceId &(void) const
+    {
+      return m_resource;
+    }
+
+    Connection
+    connection(void) const
+    {
+      return m_c.get();
+    }
+
+  private:
+    detail::connection_holder<Connection> m_c;
+    ResourceId m_resource;
+    // m_unchecked is nullptr if nothing is owned
+    free_function m_free;
+}; // class unique_resource
+
+template<typename Connection, typename ResourceId,
+         template<typename, typename> class ... Interfaces>
+struct traits<borrowed_resource<Connection, ResourceId, Interfaces ...>>
+{
+  typedef ResourceId type;
+};
+
+template<typename Connection, typename ResourceId,
+         template<typename, typename> class ... Interfaces>
+struct traits<unique_resource<Connection, ResourceId, Interfaces ...>>
+{
+  typedef ResourceId type;
+};
+
 template<typename Connection, typename ResourceId,
          template<typename, typename> class ... Interfaces>
 std::ostream &
@@ -135,6 +436,24 @@ operator<<(std::ostream & os,
   return os << std::hex << "0x" << *resource << std::dec;
 }
 
+template<typename Connection, typename ResourceId,
+         template<typename, typename> class ... Interfaces>
+std::ostream &
+operator<<(std::ostream & os,
+           const borrowed_resource<Connection, ResourceId, Interfaces ...> & resource)
+{
+  return os << std::hex << "0x" << *resource << std::dec;
+}
+
+template<typename Connection, typename ResourceId,
+         template<typename, typename> class ... Interfaces>
+std::ostream &
+operator<<(std::ostream & os,
+           const unique_resource<Connection, ResourceId, Interfaces ...> & resource)
+{
+  return os << std::hex << "0x" << *resource << std::dec;
+}
+
 } // namespace generic
 
 } // namespace xpp
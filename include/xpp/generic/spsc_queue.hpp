@@ -0,0 +1,103 @@
+#ifndef XPP_GENERIC_SPSC_QUEUE_HPP
+#define XPP_GENERIC_SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <utility> // forward, move
+
+namespace xpp { namespace generic {
+
+// Bounded lock-free queue for exactly one producer and one consumer thread
+template<typename T>
+class spsc_queue
+{
+  public:
+    explicit
+    spsc_queue(std::size_t capacity)
+      : m_slots(round_up(capacity))
+      , m_mask(m_slots.size() - 1)
+    {}
+
+    spsc_queue(const spsc_queue &) = delete;
+    spsc_queue & operator=(const spsc_queue &) = delete;
+
+    // Producer only. Returns false and leaves value untouched if full.
+    template<typename U>
+    bool
+    push(U && value)
+    {
+      const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+      if (tail - m_head_cache == m_slots.size()) {
+        m_head_cache = m_head.load(std::memory_order_acquire);
+        if (tail - m_head_cache == m_slots.size()) {
+          return false;
+        }
+      }
+
+      m_slots[tail & m_mask] = std::forward<U>(value);
+      m_tail.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    // Consumer only
+    bool
+    pop(T & value)
+    {
+      const std::size_t head = m_head.load(std::memory_order_relaxed);
+      if (head == m_tail_cache) {
+        m_tail_cache = m_tail.load(std::memory_order_acquire);
+        if (head == m_tail_cache) {
+          return false;
+        }
+      }
+
+      value = std::move(m_slots[head & m_mask]);
+      m_head.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    bool
+    empty(void) const
+    {
+      return m_head.load(std::memory_order_acquire)
+          == m_tail.load(std::memory_order_acquire);
+    }
+
+    std::size_t
+    capacity(void) const
+    {
+      return m_slots.size();
+    }
+
+  private:
+    static const std::size_t cache_line = 64;
+
+    // consumer side
+    std::atomic<std::size_t> m_head { 0 };
+    std::size_t m_tail_cache = 0;
+    char m_head_pad[cache_line];
+
+    // producer side
+    std::atomic<std::size_t> m_tail { 0 };
+    std::size_t m_head_cache = 0;
+    char m_tail_pad[cache_line];
+
+    std::vector<T> m_slots;
+    const std::size_t m_mask;
+
+    static
+    std::size_t
+    round_up(std::size_t capacity)
+    {
+      std::size_t size = 1;
+      while (size < capacity) {
+        size <<= 1;
+      }
+      return size;
+    }
+}; // class spsc_queue
+
+} } // namespace xpp::generic
+
+#endif // XPP_GENERIC_SPSC_QUEUE_HPP
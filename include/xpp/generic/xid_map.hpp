@@ -0,0 +1,166 @@
+#ifndef XPP_GENERIC_XID_MAP_HPP
+#define XPP_GENERIC_XID_MAP_HPP
+
+#include <vector>
+#include <cstdint>
+#include <utility> // move
+
+namespace xpp { namespace generic {
+
+// Open addressing hash map for XIDs with linear probing.
+// XCB_NONE (0) is never a valid resource id and marks empty slots.
+template<typename Value>
+class xid_map
+{
+  public:
+    typedef uint32_t key_type;
+    typedef Value mapped_type;
+
+    xid_map(void)
+    {}
+
+    Value *
+    find(key_type key)
+    {
+      if (key == 0 || m_size == 0) {
+        return nullptr;
+      }
+
+      for (std::size_t i = index(key); ; i = (i + 1) & mask()) {
+        if (m_slots[i].m_key == key) {
+          return &m_slots[i].m_value;
+        } else if (m_slots[i].m_key == 0) {
+          return nullptr;
+        }
+      }
+    }
+
+    const Value *
+    find(key_type key) const
+    {
+      return const_cast<xid_map *>(this)->find(key);
+    }
+
+    // Inserts a default constructed value if key is not present
+    Value &
+    operator[](key_type key)
+    {
+      if (2 * (m_size + 1) > m_slots.size()) {
+        rehash(m_slots.empty() ? 16 : 2 * m_slots.size());
+      }
+
+      std::size_t i = index(key);
+      for (; m_slots[i].m_key != 0; i = (i + 1) & mask()) {
+        if (m_slots[i].m_key == key) {
+          return m_slots[i].m_value;
+        }
+      }
+
+      ++m_size;
+      m_slots[i].m_key = key;
+      return m_slots[i].m_value;
+    }
+
+    bool
+    erase(key_type key)
+    {
+      if (key == 0 || m_size == 0) {
+        return false;
+      }
+
+      std::size_t i = index(key);
+      for (; m_slots[i].m_key != key; i = (i + 1) & mask()) {
+        if (m_slots[i].m_key == 0) {
+          return false;
+        }
+      }
+
+      // backward shift deletion: move following entries of the probe
+      // sequence into the gap, so lookups never need tombstones
+      for (std::size_t j = (i + 1) & mask(); m_slots[j].m_key != 0;
+           j = (j + 1) & mask()) {
+        std::size_t home = index(m_slots[j].m_key);
+        if (((j - home) & mask()) >= ((j - i) & mask())) {
+          m_slots[i] = std::move(m_slots[j]);
+          i = j;
+        }
+      }
+
+      m_slots[i] = slot();
+      --m_size;
+      return true;
+    }
+
+    template<typename Function>
+    void
+    for_each(Function f) const
+    {
+      for (auto & s : m_slots) {
+        if (s.m_key != 0) {
+          f(s.m_key, s.m_value);
+        }
+      }
+    }
+
+    std::size_t
+    size(void) const
+    {
+      return m_size;
+    }
+
+    bool
+    empty(void) const
+    {
+      return m_size == 0;
+    }
+
+    void
+    clear(void)
+    {
+      m_slots.clear();
+      m_size = 0;
+    }
+
+  private:
+    struct slot {
+      key_type m_key = 0;
+      Value m_value = Value();
+    };
+
+    std::vector<slot> m_slots;
+    std::size_t m_size = 0;
+
+    std::size_t
+    mask(void) const
+    {
+      return m_slots.size() - 1;
+    }
+
+    // fibonacci hashing, XIDs of one client differ mostly in the low bits
+    std::size_t
+    index(key_type key) const
+    {
+      return (static_cast<uint32_t>(key * 2654435769u) >> 7) & mask();
+    }
+
+    void
+    rehash(std::size_t capacity)
+    {
+      std::vector<slot> slots(capacity);
+      std::swap(m_slots, slots);
+
+      for (auto & s : slots) {
+        if (s.m_key != 0) {
+          std::size_t i = index(s.m_key);
+          while (m_slots[i].m_key != 0) {
+            i = (i + 1) & mask();
+          }
+          m_slots[i] = std::move(s);
+        }
+      }
+    }
+}; // class xid_map
+
+} } // namespace xpp::generic
+
+#endif // XPP_GENERIC_XID_MAP_HPP
@@ -38,10 +38,7 @@ class pixmap
         {
           xpp::x::create_pixmap(c, depth, pixmap, drawable, width, height);
         },
-        [&](const Connection & c, const xcb_pixmap_t & pixmap)
-        {
-          xpp::x::free_pixmap(c, pixmap);
-        });
+        xpp::generic::free_function { &xcb_free_pixmap, &xcb_free_pixmap_checked });
     }
 
     template<typename C>
@@ -56,13 +53,64 @@ class pixmap
         {
           xpp::x::create_pixmap_checked(c, depth, pixmap, drawable, width, height);
         },
+        xpp::generic::free_function { &xcb_free_pixmap, &xcb_free_pixmap_checked });
+    }
+};
+
+// Move-only, owning handle
+template<typename Connection, template<typename, typename> class ... Interfaces>
+class unique_pixmap
+  : public xpp::generic::unique_resource<Connection, xcb_pixmap_t,
+                                         xpp::x::pixmap, Interfaces ...>
+{
+  protected:
+    using base = xpp::generic::unique_resource<Connection, xcb_pixmap_t,
+                                               xpp::x::pixmap, Interfaces ...>;
+
+  public:
+    using base::base;
+
+    unique_pixmap(base && other)
+      : base(std::move(other))
+    {}
+
+    template<typename C>
+    static
+    unique_pixmap<Connection, Interfaces ...>
+    create(C && c, uint8_t depth, xcb_drawable_t drawable,
+                   uint16_t width, uint16_t height)
+    {
+      return base::make(
+        std::forward<C>(c),
+        [&](const Connection & c, const xcb_pixmap_t & pixmap)
+        {
+          xpp::x::create_pixmap(c, depth, pixmap, drawable, width, height);
+        },
+        xpp::generic::free_function { &xcb_free_pixmap, &xcb_free_pixmap_checked });
+    }
+
+    template<typename C>
+    static
+    unique_pixmap<Connection, Interfaces ...>
+    create_checked(C && c, uint8_t depth, xcb_drawable_t drawable,
+                   uint16_t width, uint16_t height)
+    {
+      return base::make(
+        std::forward<C>(c),
         [&](const Connection & c, const xcb_pixmap_t & pixmap)
         {
-          xpp::x::free_pixmap_checked(c, pixmap);
-        });
+          xpp::x::create_pixmap_checked(c, depth, pixmap, drawable, width, height);
+        },
+        xpp::generic::free_function { &xcb_free_pixmap, &xcb_free_pixmap_checked });
     }
 };
 
+// Non-owning handle, copying it does not allocate
+template<typename Connection, template<typename, typename> class ... Interfaces>
+using borrowed_pixmap =
+  xpp::generic::borrowed_resource<Connection, xcb_pixmap_t,
+                                  xpp::x::pixmap, Interfaces ...>;
+
 namespace generic {
 
 template<typename Connection, template<typename, typename> class ... Interfaces>
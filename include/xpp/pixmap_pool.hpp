@@ -0,0 +1,293 @@
+#ifndef XPP_PIXMAP_POOL_HPP
+#define XPP_PIXMAP_POOL_HPP
+
+#include <list>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#include "pixmap.hpp"
+
+namespace xpp {
+
+// Recycles offscreen pixmaps. Sizes are rounded up to buckets with at most 25%
+// overhead per dimension, a lease for (depth, width, height) may return any
+// idle pixmap of the same bucket. The contents of a leased pixmap are
+// undefined. Idle pixmaps are freed least recently used first when they take
+// more than budget bytes on the server.
+template<typename Connection>
+class pixmap_pool
+{
+  protected:
+    typedef xpp::unique_pixmap<Connection> pixmap_type;
+
+    struct entry {
+      uint64_t m_key;
+      std::size_t m_bytes;
+      pixmap_type m_pixmap;
+    };
+
+    struct state {
+      std::mutex m_mutex;
+      std::size_t m_budget;
+      std::size_t m_idle_bytes = 0;
+      uint64_t m_hits = 0;
+      uint64_t m_misses = 0;
+      uint64_t m_evictions = 0;
+      // most recently used at the front
+      std::list<entry> m_idle;
+      std::unordered_map<uint64_t,
+                         std::vector<typename std::list<entry>::iterator>> m_index;
+
+      void
+      give_back(uint64_t key, std::size_t bytes, pixmap_type && pixmap)
+      {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_idle.push_front(entry { key, bytes, std::move(pixmap) });
+        m_index[key].push_back(m_idle.begin());
+        m_idle_bytes += bytes;
+        evict();
+      }
+
+      void
+      evict(void)
+      {
+        while (m_idle_bytes > m_budget && ! m_idle.empty()) {
+          auto last = std::prev(m_idle.end());
+          auto & slots = m_index[last->m_key];
+          for (auto s = slots.begin(); s != slots.end(); ++s) {
+            if (*s == last) {
+              slots.erase(s);
+              break;
+            }
+          }
+          if (slots.empty()) {
+            m_index.erase(last->m_key);
+          }
+          m_idle_bytes -= last->m_bytes;
+          ++m_evictions;
+          m_idle.erase(last);
+        }
+      }
+    };
+
+  public:
+    // Returns its pixmap to the pool when it goes out of scope
+    class lease
+    {
+      public:
+        lease(lease && other) = default;
+
+        lease &
+        operator=(lease && other)
+        {
+          if (this != &other) {
+            give_back();
+            m_state = std::move(other.m_state);
+            m_key = other.m_key;
+            m_bytes = other.m_bytes;
+            m_pixmap = std::move(other.m_pixmap);
+          }
+          return *this;
+        }
+
+        ~lease(void)
+        {
+          give_back();
+        }
+
+        const xcb_pixmap_t &
+        operator*(void) const
+        {
+          return *m_pixmap;
+        }
+
+        operator const xcb_pixmap_t &(void) const
+        {
+          return *m_pixmap;
+        }
+
+        const pixmap_type *
+        operator->(void) const
+        {
+          return &m_pixmap;
+        }
+
+        uint8_t
+        depth(void) const
+        {
+          return m_key >> 32;
+        }
+
+        // The actual size, at least the requested one
+        uint16_t
+        width(void) const
+        {
+          return (m_key >> 16) & 0xffff;
+        }
+
+        uint16_t
+        height(void) const
+        {
+          return m_key & 0xffff;
+        }
+
+      private:
+        friend class pixmap_pool;
+
+        std::weak_ptr<state> m_state;
+        uint64_t m_key;
+        std::size_t m_bytes;
+        pixmap_type m_pixmap;
+
+        lease(const std::shared_ptr<state> & s, uint64_t key, std::size_t bytes,
+              pixmap_type && pixmap)
+          : m_state(s), m_key(key), m_bytes(bytes), m_pixmap(std::move(pixmap))
+        {}
+
+        void
+        give_back(void)
+        {
+          // the pixmap is freed if the pool is gone
+          auto s = m_state.lock();
+          if (s) {
+            s->give_back(m_key, m_bytes, std::move(m_pixmap));
+          }
+          m_state.reset();
+        }
+    }; // class lease
+
+    // Pixmaps are created for the screen of drawable
+    template<typename C>
+    pixmap_pool(C && c, xcb_drawable_t drawable, std::size_t budget)
+      : m_c(std::forward<C>(c))
+      , m_drawable(drawable)
+      , m_state(std::make_shared<state>())
+    {
+      m_state->m_budget = budget;
+    }
+
+    pixmap_pool(const pixmap_pool &) = delete;
+    pixmap_pool & operator=(const pixmap_pool &) = delete;
+
+    lease
+    acquire(uint8_t depth, uint16_t width, uint16_t height)
+    {
+      const uint16_t w = bucket(width);
+      const uint16_t h = bucket(height);
+      const uint64_t key = uint64_t(depth) << 32 | uint32_t(w) << 16 | h;
+      const std::size_t bytes = size(depth, w, h);
+
+      {
+        std::lock_guard<std::mutex> guard(m_state->m_mutex);
+        auto slots = m_state->m_index.find(key);
+        if (slots != m_state->m_index.end()) {
+          auto item = slots->second.back();
+          slots->second.pop_back();
+          if (slots->second.empty()) {
+            m_state->m_index.erase(slots);
+          }
+          pixmap_type pixmap = std::move(item->m_pixmap);
+          m_state->m_idle_bytes -= item->m_bytes;
+          m_state->m_idle.erase(item);
+          ++m_state->m_hits;
+          return lease(m_state, key, bytes, std::move(pixmap));
+        }
+        ++m_state->m_misses;
+      }
+
+      return lease(m_state, key, bytes,
+                   pixmap_type::create(m_c, depth, m_drawable, w, h));
+    }
+
+    void
+    budget(std::size_t bytes)
+    {
+      std::lock_guard<std::mutex> guard(m_state->m_mutex);
+      m_state->m_budget = bytes;
+      m_state->evict();
+    }
+
+    // Frees all idle pixmaps
+    void
+    clear(void)
+    {
+      std::lock_guard<std::mutex> guard(m_state->m_mutex);
+      m_state->m_idle.clear();
+      m_state->m_index.clear();
+      m_state->m_idle_bytes = 0;
+    }
+
+    uint64_t
+    hits(void) const
+    {
+      std::lock_guard<std::mutex> guard(m_state->m_mutex);
+      return m_state->m_hits;
+    }
+
+    uint64_t
+    misses(void) const
+    {
+      std::lock_guard<std::mutex> guard(m_state->m_mutex);
+      return m_state->m_misses;
+    }
+
+    uint64_t
+    evictions(void) const
+    {
+      std::lock_guard<std::mutex> guard(m_state->m_mutex);
+      return m_state->m_evictions;
+    }
+
+    // Estimated server memory of the idle pixmaps
+    std::size_t
+    idle_bytes(void) const
+    {
+      std::lock_guard<std::mutex> guard(m_state->m_mutex);
+      return m_state->m_idle_bytes;
+    }
+
+    // Keeps the two bits below the most significant one
+    static
+    uint16_t
+    bucket(uint16_t value)
+    {
+      if (value <= 8) {
+        return 8;
+      }
+      const unsigned int shift = 31 - __builtin_clz(value) - 2;
+      const uint32_t step = 1u << shift;
+      const uint32_t rounded = (uint32_t(value) + step - 1) & ~(step - 1);
+      return rounded > 0xffff ? 0xffff : rounded;
+    }
+
+  protected:
+    Connection m_c;
+    xcb_drawable_t m_drawable;
+    std::shared_ptr<state> m_state;
+    // bits per pixel, by depth
+    std::unordered_map<uint8_t, uint8_t> m_formats;
+
+    std::size_t
+    size(uint8_t depth, uint16_t width, uint16_t height)
+    {
+      std::lock_guard<std::mutex> guard(m_state->m_mutex);
+      if (m_formats.empty()) {
+        auto formats = xcb_setup_pixmap_formats_iterator(xcb_get_setup(m_c));
+        for (; formats.rem; xcb_format_next(&formats)) {
+          m_formats[formats.data->depth] = formats.data->bits_per_pixel;
+        }
+      }
+
+      auto format = m_formats.find(depth);
+      const std::size_t bits = format == m_formats.end() ? 32 : format->second;
+      // rows are padded to 32 bits
+      return (width * bits + 31) / 32 * 4 * height;
+    }
+}; // class pixmap_pool
+
+} // namespace xpp
+
+#endif // XPP_PIXMAP_POOL_HPP
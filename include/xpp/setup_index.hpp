@@ -0,0 +1,178 @@
+#ifndef XPP_SETUP_INDEX_HPP
+#define XPP_SETUP_INDEX_HPP
+
+#include <array>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <xcb/xcb.h>
+
+namespace xpp {
+
+// Lookup tables for the connection setup data, built once instead of walking
+// the nested screen, depth and visual lists for every lookup. Pointers point
+// into the setup data and are valid as long as the connection.
+class setup_index
+{
+  public:
+    struct visual_info {
+      int m_screen;
+      uint8_t m_depth;
+      xcb_visualtype_t * m_visual;
+    };
+
+    // setup may be nullptr for a connection in error state
+    explicit
+    setup_index(const xcb_setup_t * setup)
+    {
+      m_formats.fill(nullptr);
+      if (! setup) {
+        return;
+      }
+
+      auto formats = xcb_setup_pixmap_formats_iterator(setup);
+      for (; formats.rem; xcb_format_next(&formats)) {
+        m_formats[formats.data->depth] = formats.data;
+      }
+
+      auto screens = xcb_setup_roots_iterator(setup);
+      for (int screen = 0; screens.rem; ++screen, xcb_screen_next(&screens)) {
+        m_screens.push_back(screens.data);
+        m_roots.emplace(screens.data->root, screen);
+        m_argb_visuals.push_back(nullptr);
+
+        auto depths = xcb_screen_allowed_depths_iterator(screens.data);
+        for (; depths.rem; xcb_depth_next(&depths)) {
+          const uint8_t depth = depths.data->depth;
+          auto visuals = xcb_depth_visuals_iterator(depths.data);
+          for (; visuals.rem; xcb_visualtype_next(&visuals)) {
+            m_visuals.emplace(visuals.data->visual_id,
+                              visual_info { screen, depth, visuals.data });
+          }
+        }
+      }
+
+      // references into m_visuals stay valid, it is not modified anymore
+      for (auto & visual : m_visuals) {
+        auto & argb = m_argb_visuals[visual.second.m_screen];
+        if (better_argb(visual.second, argb)) {
+          argb = &visual.second;
+        }
+      }
+    }
+
+    setup_index(const setup_index &) = delete;
+    setup_index & operator=(const setup_index &) = delete;
+
+    // An index of a copy of setup, valid after the connection is gone. For
+    // connections to the same display, e.g. xpp::shared_setup.
+    static
+    std::shared_ptr<const setup_index>
+    copy(const xcb_setup_t * setup)
+    {
+      struct copied {
+        // the length counts 4 byte units after the first 8 bytes
+        std::vector<uint32_t> m_data;
+        std::unique_ptr<setup_index> m_index;
+      };
+
+      auto c = std::make_shared<copied>();
+      if (setup) {
+        auto * words = reinterpret_cast<const uint32_t *>(setup);
+        c->m_data.assign(words, words + 2 + setup->length);
+      }
+      c->m_index.reset(new setup_index(setup
+          ? reinterpret_cast<const xcb_setup_t *>(c->m_data.data())
+          : nullptr));
+      return std::shared_ptr<const setup_index>(c, c->m_index.get());
+    }
+
+    std::size_t
+    screens(void) const
+    {
+      return m_screens.size();
+    }
+
+    // nullptr if there is no such screen
+    xcb_screen_t *
+    screen(int screen) const
+    {
+      if (screen < 0 || std::size_t(screen) >= m_screens.size()) {
+        return nullptr;
+      }
+      return m_screens[screen];
+    }
+
+    // -1 if root is not a root window
+    int
+    screen_of_root(xcb_window_t root) const
+    {
+      auto item = m_roots.find(root);
+      return item == m_roots.end() ? -1 : item->second;
+    }
+
+    const visual_info *
+    visual(xcb_visualid_t id) const
+    {
+      auto item = m_visuals.find(id);
+      return item == m_visuals.end() ? nullptr : &item->second;
+    }
+
+    // A 32 bit TrueColor visual, preferably with 8 bits per channel in the
+    // low 24 bits, as used for ARGB32 pictures. nullptr if there is none.
+    const visual_info *
+    argb_visual(int screen) const
+    {
+      if (screen < 0 || std::size_t(screen) >= m_argb_visuals.size()) {
+        return nullptr;
+      }
+      return m_argb_visuals[screen];
+    }
+
+    // nullptr if the server has no pixmap format for depth
+    const xcb_format_t *
+    format(uint8_t depth) const
+    {
+      return m_formats[depth];
+    }
+
+  protected:
+    std::vector<xcb_screen_t *> m_screens;
+    std::unordered_map<xcb_window_t, int> m_roots;
+    std::unordered_map<xcb_visualid_t, visual_info> m_visuals;
+    std::vector<const visual_info *> m_argb_visuals;
+    std::array<xcb_format_t *, 256> m_formats;
+
+    static
+    bool
+    better_argb(const visual_info & candidate, const visual_info * best)
+    {
+      auto rank = [](const visual_info & v)
+      {
+        if (v.m_depth != 32
+            || v.m_visual->_class != XCB_VISUAL_CLASS_TRUE_COLOR) {
+          return 0;
+        }
+        return v.m_visual->red_mask == 0xff0000
+            && v.m_visual->green_mask == 0xff00
+            && v.m_visual->blue_mask == 0xff ? 2 : 1;
+      };
+
+      const int r = rank(candidate);
+      if (r == 0) {
+        return false;
+      }
+      if (! best) {
+        return true;
+      }
+      const int b = rank(*best);
+      // the lowest id of the best rank, independent of the hash order
+      return r > b || (r == b
+          && candidate.m_visual->visual_id < best->m_visual->visual_id);
+    }
+}; // class setup_index
+
+} // namespace xpp
+
+#endif // XPP_SETUP_INDEX_HPP
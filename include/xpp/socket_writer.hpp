@@ -0,0 +1,338 @@
+#ifndef XPP_SOCKET_WRITER_HPP
+#define XPP_SOCKET_WRITER_HPP
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <sys/uio.h> // iovec
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h> // xcb_take_socket, xcb_writev
+
+#include "core.hpp"
+
+namespace xpp {
+
+// Encodes requests without a reply into a buffer of its own and writes it to
+// the socket directly, bypassing xcb_send_request. The socket is taken from
+// xcb on first use and given back when xcb needs it, e.g. when another thread
+// sends a request through xcb, or on release(). Every 65534 requests a
+// GetInputFocus is inserted, so that xcb can widen sequence numbers; its reply
+// is discarded. Errors are delivered as events, like for unchecked requests.
+// Requests are taken as the xcb request structs, e.g.
+// xcb_poly_fill_rectangle_request_t, the length field is filled in.
+//
+// Example:
+//   xpp::socket_writer w(c);
+//   w.poly_fill_rectangle(window, gc, rectangles.size(), rectangles.data());
+//   w.release();
+class socket_writer
+{
+  public:
+    // Requests which do not fit into capacity bytes are written without
+    // copying their data
+    explicit
+    socket_writer(xcb_connection_t * c, std::size_t capacity = 64 * 1024)
+      : m_c(c)
+      // requests with BIG-REQUESTS encoding are not supported
+      , m_max_request(std::min<std::size_t>(
+            xcb_get_maximum_request_length(c), UINT16_MAX) * 4)
+    {
+      m_buffer.reserve(std::max<std::size_t>(capacity, 1024));
+    }
+
+    socket_writer(const socket_writer &) = delete;
+    socket_writer & operator=(const socket_writer &) = delete;
+
+    ~socket_writer(void)
+    {
+      release();
+    }
+
+    // Returns the sequence number of the request. data is padded to 4 bytes.
+    template<typename Request>
+    uint64_t
+    request(const Request & fixed, const void * data = nullptr,
+            std::size_t size = 0)
+    {
+      return encode(&fixed, sizeof(Request), 0, data, size);
+    }
+
+    // The major opcode of extension is filled in
+    template<typename Request>
+    uint64_t
+    request(xcb_extension_t * extension, const Request & fixed,
+            const void * data = nullptr, std::size_t size = 0)
+    {
+      // may be a round trip through xcb, which takes the socket back
+      const xcb_query_extension_reply_t * reply =
+        xcb_get_extension_data(m_c, extension);
+      if (! reply || ! reply->present) {
+        throw std::runtime_error(
+            std::string("socket_writer: extension not present: ")
+            + extension->name);
+      }
+      return encode(&fixed, sizeof(Request), reply->major_opcode, data, size);
+    }
+
+    // length is the number of format bit elements
+    uint64_t
+    change_property(uint8_t mode, xcb_window_t window, xcb_atom_t property,
+                    xcb_atom_t type, uint8_t format, uint32_t length,
+                    const void * data)
+    {
+      xcb_change_property_request_t r {};
+      r.major_opcode = XCB_CHANGE_PROPERTY;
+      r.mode = mode;
+      r.window = window;
+      r.property = property;
+      r.type = type;
+      r.format = format;
+      r.data_len = length;
+      return request(r, data, std::size_t(length) * format / 8);
+    }
+
+    uint64_t
+    put_image(uint8_t format, xcb_drawable_t drawable, xcb_gcontext_t gc,
+              uint16_t width, uint16_t height, int16_t dst_x, int16_t dst_y,
+              uint8_t left_pad, uint8_t depth, std::size_t size,
+              const uint8_t * data)
+    {
+      xcb_put_image_request_t r {};
+      r.major_opcode = XCB_PUT_IMAGE;
+      r.format = format;
+      r.drawable = drawable;
+      r.gc = gc;
+      r.width = width;
+      r.height = height;
+      r.dst_x = dst_x;
+      r.dst_y = dst_y;
+      r.left_pad = left_pad;
+      r.depth = depth;
+      return request(r, data, size);
+    }
+
+    uint64_t
+    poly_fill_rectangle(xcb_drawable_t drawable, xcb_gcontext_t gc,
+                        std::size_t n, const xcb_rectangle_t * rectangles)
+    {
+      xcb_poly_fill_rectangle_request_t r {};
+      r.major_opcode = XCB_POLY_FILL_RECTANGLE;
+      r.drawable = drawable;
+      r.gc = gc;
+      return request(r, rectangles, n * sizeof(xcb_rectangle_t));
+    }
+
+    uint64_t
+    poly_segment(xcb_drawable_t drawable, xcb_gcontext_t gc,
+                 std::size_t n, const xcb_segment_t * segments)
+    {
+      xcb_poly_segment_request_t r {};
+      r.major_opcode = XCB_POLY_SEGMENT;
+      r.drawable = drawable;
+      r.gc = gc;
+      return request(r, segments, n * sizeof(xcb_segment_t));
+    }
+
+    uint64_t
+    copy_area(xcb_drawable_t src_drawable, xcb_drawable_t dst_drawable,
+              xcb_gcontext_t gc, int16_t src_x, int16_t src_y,
+              int16_t dst_x, int16_t dst_y, uint16_t width, uint16_t height)
+    {
+      xcb_copy_area_request_t r {};
+      r.major_opcode = XCB_COPY_AREA;
+      r.src_drawable = src_drawable;
+      r.dst_drawable = dst_drawable;
+      r.gc = gc;
+      r.src_x = src_x;
+      r.src_y = src_y;
+      r.dst_x = dst_x;
+      r.dst_y = dst_y;
+      r.width = width;
+      r.height = height;
+      return request(r);
+    }
+
+    // Writes the buffered requests, the socket is kept
+    void
+    flush(void)
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      if (! write()) {
+        fail("xcb_writev");
+      }
+    }
+
+    // Writes the buffered requests and gives the socket back to xcb. Sends a
+    // GetInputFocus through xcb, which resets the sequence bookkeeping of xcb.
+    void
+    release(void)
+    {
+      {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (! m_owned) {
+          return;
+        }
+      }
+      // xcb calls give_back() before sending it
+      xcb_discard_reply(m_c, xcb_get_input_focus(m_c).sequence);
+    }
+
+    // The sequence number of the last request sent through this writer
+    uint64_t
+    sequence(void) const
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      return m_sequence;
+    }
+
+  protected:
+    xcb_connection_t * m_c;
+    const std::size_t m_max_request;
+
+    mutable std::mutex m_mutex;
+    bool m_owned = false;
+    std::vector<uint8_t> m_buffer;
+    // in m_buffer
+    uint64_t m_requests = 0;
+    uint64_t m_sequence = 0;
+    // of the last request with a reply
+    uint64_t m_reply = 0;
+    // GetInputFocus requests in m_buffer
+    std::vector<uint64_t> m_syncs;
+
+    static
+    void
+    give_back(void * closure)
+    {
+      auto * self = static_cast<socket_writer *>(closure);
+      std::lock_guard<std::mutex> guard(self->m_mutex);
+      // on failure the connection is in error state, which xcb reports
+      self->write();
+      self->m_owned = false;
+    }
+
+    // m_mutex must be locked
+    bool
+    write(const void * data = nullptr, std::size_t size = 0)
+    {
+      static const uint8_t zeros[3] = {};
+      if (m_buffer.empty()) {
+        return true;
+      }
+
+      iovec iov[3] = {
+        { m_buffer.data(), m_buffer.size() },
+        { const_cast<void *>(data), size },
+        { const_cast<uint8_t *>(zeros), pad(size) - size }
+      };
+      const bool ok = xcb_writev(m_c, iov, data ? 3 : 1, m_requests) != 0;
+      m_buffer.clear();
+      m_requests = 0;
+
+      for (auto sequence : m_syncs) {
+        xcb_discard_reply64(m_c, sequence);
+      }
+      m_syncs.clear();
+      return ok;
+    }
+
+    uint64_t
+    encode(const void * fixed, std::size_t fixed_size, uint8_t major_opcode,
+           const void * data, std::size_t size)
+    {
+      const std::size_t length = fixed_size + pad(size);
+      if (length > m_max_request) {
+        throw std::length_error("socket_writer: request too long");
+      }
+
+      std::lock_guard<std::mutex> guard(m_mutex);
+      if (! m_owned) {
+        take();
+      }
+      if (m_sequence - m_reply >= UINT16_MAX - 1) {
+        sync();
+      }
+
+      // otherwise data is written from where it is, after the buffer
+      const bool copy = length <= m_buffer.capacity();
+      if (m_buffer.size() + (copy ? length : fixed_size) > m_buffer.capacity()
+          && ! write()) {
+        fail("xcb_writev");
+      }
+
+      const std::size_t offset = m_buffer.size();
+      m_buffer.insert(m_buffer.end(), static_cast<const uint8_t *>(fixed),
+                      static_cast<const uint8_t *>(fixed) + fixed_size);
+      if (major_opcode != 0) {
+        m_buffer[offset] = major_opcode;
+      }
+      const uint16_t words = length / 4;
+      std::memcpy(&m_buffer[offset + 2], &words, sizeof(words));
+      ++m_requests;
+      ++m_sequence;
+      const uint64_t sequence = m_sequence;
+
+      if (copy) {
+        m_buffer.insert(m_buffer.end(), static_cast<const uint8_t *>(data),
+                        static_cast<const uint8_t *>(data) + size);
+        m_buffer.resize(m_buffer.size() + pad(size) - size, 0);
+      } else if (! write(data, size)) {
+        fail("xcb_writev");
+      }
+      return sequence;
+    }
+
+    // m_mutex must be locked
+    void
+    take(void)
+    {
+      uint64_t sent = 0;
+      if (! xcb_take_socket(m_c, &socket_writer::give_back, this, 0, &sent)) {
+        fail("xcb_take_socket");
+      }
+      m_owned = true;
+      m_sequence = sent;
+      // xcb requires the first request to have a reply
+      sync();
+    }
+
+    // m_mutex must be locked
+    void
+    sync(void)
+    {
+      if (m_buffer.size() + sizeof(xcb_get_input_focus_request_t)
+          > m_buffer.capacity() && ! write()) {
+        fail("xcb_writev");
+      }
+      xcb_get_input_focus_request_t r {};
+      r.major_opcode = XCB_GET_INPUT_FOCUS;
+      r.length = 1;
+      const uint8_t * bytes = reinterpret_cast<const uint8_t *>(&r);
+      m_buffer.insert(m_buffer.end(), bytes, bytes + sizeof(r));
+      ++m_requests;
+      m_reply = ++m_sequence;
+      m_syncs.push_back(m_reply);
+    }
+
+    void
+    fail(const std::string & producer) const
+    {
+      throw xpp::connection_error(xcb_connection_has_error(m_c),
+                                  "socket_writer: " + producer + " failed");
+    }
+
+    static
+    std::size_t
+    pad(std::size_t size)
+    {
+      return (size + 3) & ~std::size_t(3);
+    }
+}; // class socket_writer
+
+} // namespace xpp
+
+#endif // XPP_SOCKET_WRITER_HPP
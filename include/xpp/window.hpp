@@ -44,10 +44,7 @@ class window
                                         _class, visual,
                                         value_mask, value_list);
         },
-        [&](const Connection & c, const xcb_window_t & window)
-        {
-          xpp::x::destroy_window(c, window);
-        });
+        xpp::generic::free_function { &xcb_destroy_window, &xcb_destroy_window_checked });
     }
 
     template<typename C>
@@ -68,13 +65,77 @@ class window
                                         _class, visual,
                                         value_mask, value_list);
         },
+        xpp::generic::free_function { &xcb_destroy_window, &xcb_destroy_window_checked });
+    }
+};
+
+// Move-only, owning handle
+template<typename Connection, template<typename, typename> class ... Interfaces>
+class unique_window
+  : public xpp::generic::unique_resource<Connection, xcb_window_t,
+                                         xpp::x::window, Interfaces ...>
+{
+  protected:
+    using base = xpp::generic::unique_resource<Connection, xcb_window_t,
+                                               xpp::x::window, Interfaces ...>;
+
+  public:
+    using base::base;
+
+    unique_window(base && other)
+      : base(std::move(other))
+    {}
+
+    template<typename C>
+    static
+    unique_window<Connection, Interfaces ...>
+    create(C && c, uint8_t depth, xcb_window_t parent,
+                   int16_t x, int16_t y, uint16_t width, uint16_t height,
+                   uint16_t border_width,
+                   uint16_t _class, xcb_visualid_t visual,
+                   uint32_t value_mask, const uint32_t * value_list)
+    {
+      return base::make(
+        std::forward<C>(c),
+        [&](const Connection & c, const xcb_window_t & window)
+        {
+          xpp::x::create_window(c, depth, window, parent,
+                                        x, y, width, height, border_width,
+                                        _class, visual,
+                                        value_mask, value_list);
+        },
+        xpp::generic::free_function { &xcb_destroy_window, &xcb_destroy_window_checked });
+    }
+
+    template<typename C>
+    static
+    unique_window<Connection, Interfaces ...>
+    create_checked(C && c, uint8_t depth, xcb_window_t parent,
+                   int16_t x, int16_t y, uint16_t width, uint16_t height,
+                   uint16_t border_width,
+                   uint16_t _class, xcb_visualid_t visual,
+                   uint32_t value_mask, const uint32_t * value_list)
+    {
+      return base::make(
+        std::forward<C>(c),
         [&](const Connection & c, const xcb_window_t & window)
         {
-          xpp::x::destroy_window_checked(c, window);
-        });
+          xpp::x::create_window_checked(c, depth, window, parent,
+                                        x, y, width, height, border_width,
+                                        _class, visual,
+                                        value_mask, value_list);
+        },
+        xpp::generic::free_function { &xcb_destroy_window, &xcb_destroy_window_checked });
     }
 };
 
+// Non-owning handle, copying it does not allocate, e.g. for walking the tree:
+//   c.query_tree(root).children<xpp::borrowed_window<my_connection &>>()
+template<typename Connection, template<typename, typename> class ... Interfaces>
+using borrowed_window =
+  xpp::generic::borrowed_resource<Connection, xcb_window_t,
+                                  xpp::x::window, Interfaces ...>;
+
 namespace generic {
 
 template<typename Connection, template<typename, typename> class ... Interfaces>
@@ -0,0 +1,247 @@
+#ifndef XPP_XID_ALLOCATOR_HPP
+#define XPP_XID_ALLOCATOR_HPP
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+#include "core.hpp"
+#include "proto/xc_misc.hpp"
+#include "generic/id_allocator.hpp"
+
+namespace xpp {
+
+// Resource ids for long running connections:
+//   c.allocate_ids(std::make_shared<xpp::xid_allocator>(c));
+// Ids are handed out from a range with a single compare and swap. Ids of
+// freed resources are reused once a round trip confirmed the free (see
+// core::flush_checked()). When the range of the connection is used up, new
+// ranges are requested with XC-MISC ahead of time. Without XC-MISC on the
+// server, generate() throws once the range and the freed ids are used up.
+class xid_allocator
+  : public xpp::generic::id_allocator
+{
+  public:
+    // Takes over the ids which xcb_generate_id has not handed out yet.
+    // Throws xpp::connection_error if c is in an error state, which has
+    // neither ids nor setup data.
+    explicit
+    xid_allocator(xcb_connection_t * c, uint32_t low_water = 1024)
+      : m_c(c)
+      , m_low_water(low_water)
+    {
+      xpp::check_connection(c);
+      const uint32_t first = xcb_generate_id(c);
+      const xcb_setup_t * setup = xcb_get_setup(c);
+      const uint32_t mask = setup->resource_id_mask;
+      m_inc = mask & -mask;
+      install(first, setup->resource_id_base + mask + m_inc);
+    }
+
+    xid_allocator(const xid_allocator &) = delete;
+    xid_allocator & operator=(const xid_allocator &) = delete;
+
+    uint32_t
+    generate(void)
+    {
+      uint64_t range = m_range.load(std::memory_order_relaxed);
+      while (next(range) < end(range)) {
+        const uint64_t advanced = range + (uint64_t(m_inc) << 32);
+        if (m_range.compare_exchange_weak(range, advanced,
+                                          std::memory_order_relaxed)) {
+          if ((end(advanced) - next(advanced)) / m_inc == m_low_water) {
+            prefetch();
+          }
+          return next(range);
+        }
+      }
+      return refill();
+    }
+
+    void
+    release(uint32_t xid)
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      m_released.push_back(xid);
+    }
+
+    void
+    confirm(void)
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      m_free.insert(m_free.end(), m_released.begin(), m_released.end());
+      m_released.clear();
+    }
+
+    // Ids which can be handed out without a round trip
+    std::size_t
+    available(void) const
+    {
+      const uint64_t range = m_range.load(std::memory_order_relaxed);
+      std::lock_guard<std::mutex> guard(m_mutex);
+      return (end(range) - next(range)) / m_inc + m_free.size();
+    }
+
+  private:
+    typedef xpp::xc_misc::reply::checked::get_xid_range<xcb_connection_t *>
+      xid_range;
+
+    xcb_connection_t * m_c;
+    uint32_t m_inc;
+    uint32_t m_low_water;
+    // next id << 32 | end of the range
+    std::atomic<uint64_t> m_range { 0 };
+    // first id of the current range
+    uint32_t m_start = 0;
+
+    mutable std::mutex m_mutex;
+    // -1: not queried yet
+    int m_xc_misc = -1;
+    // sent frees, waiting for confirmation
+    std::vector<uint32_t> m_released;
+    std::vector<uint32_t> m_free;
+    std::unique_ptr<xid_range> m_prefetch;
+
+    static
+    uint32_t
+    next(uint64_t range)
+    {
+      return range >> 32;
+    }
+
+    static
+    uint32_t
+    end(uint64_t range)
+    {
+      return range & 0xffffffff;
+    }
+
+    void
+    install(uint32_t start, uint32_t end)
+    {
+      m_start = start;
+      m_range.store(uint64_t(start) << 32 | end, std::memory_order_relaxed);
+    }
+
+    // m_mutex must be locked
+    bool
+    xc_misc(void)
+    {
+      if (m_xc_misc == -1) {
+        const xcb_query_extension_reply_t * reply =
+          xcb_get_extension_data(m_c, &xcb_xc_misc_id);
+        m_xc_misc = reply && reply->present;
+      }
+      return m_xc_misc;
+    }
+
+    // m_mutex must be locked
+    void
+    request_range(void)
+    {
+      if (! xc_misc()) {
+        throw std::runtime_error(
+            "xid_allocator: no resource ids left, XC-MISC is not present");
+      }
+      m_prefetch.reset(new xid_range(m_c));
+    }
+
+    // Only when nothing was freed, recycling is cheaper. Without XC-MISC,
+    // refill() reports the exhaustion, there may be ids left until then.
+    void
+    prefetch(void)
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      if (! m_prefetch && m_free.empty() && xc_misc()) {
+        request_range();
+      }
+    }
+
+    uint32_t
+    refill(void)
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      while (true) {
+        uint64_t range = m_range.load(std::memory_order_relaxed);
+        if (next(range) < end(range)) {
+          const uint64_t advanced = range + (uint64_t(m_inc) << 32);
+          if (m_range.compare_exchange_strong(range, advanced,
+                                              std::memory_order_relaxed)) {
+            return next(range);
+          }
+          continue;
+        }
+
+        // a requested range must be installed before freed ids are handed
+        // out, it may contain them
+        if (! m_prefetch && ! m_free.empty()) {
+          const uint32_t xid = m_free.back();
+          m_free.pop_back();
+          return xid;
+        }
+
+        if (! m_prefetch) {
+          request_range();
+        }
+        install_prefetched();
+      }
+    }
+
+    void
+    install_prefetched(void)
+    {
+      std::unique_ptr<xid_range> reply = std::move(m_prefetch);
+      const uint64_t count = (*reply)->count;
+      // the server answers start_id 0 and count 1 when it has no ids left
+      if (count == 0 || ((*reply)->start_id == 0 && count == 1)) {
+        if (m_free.empty()) {
+          throw std::runtime_error("xid_allocator: no resource ids left");
+        }
+        return;
+      }
+
+      uint64_t start = (*reply)->start_id;
+      uint64_t end = start + count * m_inc;
+
+      // ids of the current range may not be in use on the server yet, only
+      // keep the larger part outside of it
+      const uint64_t used_start = m_start;
+      const uint64_t used_end = this->end(m_range.load(std::memory_order_relaxed));
+      if (start < used_end && used_start < end) {
+        const uint64_t lower =
+          used_start > start ? std::min(end, used_start) - start : 0;
+        const uint64_t upper =
+          end > used_end ? end - std::max(start, used_end) : 0;
+        if (lower >= upper) {
+          end = start + lower;
+        } else {
+          start = std::max(start, used_end);
+        }
+      }
+      if (start >= end) {
+        return;
+      }
+
+      // freed ids in the range are handed out from the range
+      auto outside = [&](uint32_t xid) { return xid < start || xid >= end; };
+      m_free.erase(std::partition(m_free.begin(), m_free.end(), outside),
+                   m_free.end());
+      m_released.erase(std::partition(m_released.begin(), m_released.end(), outside),
+                       m_released.end());
+
+      install(start, end);
+
+      // too small to trigger a prefetch from generate()
+      if ((end - start) / m_inc <= m_low_water && m_free.empty()) {
+        request_range();
+      }
+    }
+}; // class xid_allocator
+
+} // namespace xpp
+
+#endif // XPP_XID_ALLOCATOR_HPP
@@ -4,16 +4,29 @@
 #include "generic.hpp"
 
 #include "atom.hpp"
+#include "atom_cache.hpp"
+#include "color_cache.hpp"
 #include "colormap.hpp"
 #include "cursor.hpp"
 #include "drawable.hpp"
 #include "font.hpp"
+#include "font_metrics.hpp"
 #include "fontable.hpp"
 #include "gcontext.hpp"
+#include "gc_cache.hpp"
 #include "pixmap.hpp"
+#include "pixmap_pool.hpp"
 #include "window.hpp"
 
 #include "event.hpp"
+#include "event/static_registry.hpp"
+#include "event/batch.hpp"
+#include "event/loop.hpp"
+#include "event/special.hpp"
+#include "event/recorder.hpp"
 #include "connection.hpp"
+#include "connection_pool.hpp"
+#include "flush_scheduler.hpp"
+#include "socket_writer.hpp"
 
 #endif // XPP_HPP
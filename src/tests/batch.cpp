@@ -0,0 +1,201 @@
+#include <deque>
+#include <vector>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+
+#include "../../include/xpp/event/batch.hpp"
+
+// Hands out the queued events, like libxcb after a read
+struct connection {
+  std::deque<xcb_generic_event_t *> m_queue;
+
+  xpp::generic::event_ptr
+  poll_for_queued_event(void)
+  {
+    if (m_queue.empty()) {
+      return nullptr;
+    }
+    auto * event = m_queue.front();
+    m_queue.pop_front();
+    return xpp::generic::event_ptr(event);
+  }
+
+  xpp::generic::event_ptr
+  wait_for_event(void)
+  {
+    return poll_for_queued_event();
+  }
+};
+
+struct registry {
+  std::vector<xcb_generic_event_t> m_events;
+
+  void
+  dispatch(const xpp::generic::event_ptr & event)
+  {
+    m_events.push_back(*event);
+  }
+};
+
+template<typename Event>
+Event *
+make(uint8_t response_type)
+{
+  auto * event = static_cast<Event *>(std::calloc(1, sizeof(xcb_generic_event_t)));
+  event->response_type = response_type;
+  return event;
+}
+
+xcb_generic_event_t *
+expose(xcb_window_t window, int16_t x, int16_t y, uint16_t w, uint16_t h,
+       uint16_t count)
+{
+  auto * e = make<xcb_expose_event_t>(XCB_EXPOSE);
+  e->window = window;
+  e->x = x; e->y = y; e->width = w; e->height = h;
+  e->count = count;
+  return reinterpret_cast<xcb_generic_event_t *>(e);
+}
+
+xcb_generic_event_t *
+motion(xcb_window_t window, int16_t x)
+{
+  auto * e = make<xcb_motion_notify_event_t>(XCB_MOTION_NOTIFY);
+  e->event = window;
+  e->event_x = x;
+  return reinterpret_cast<xcb_generic_event_t *>(e);
+}
+
+xcb_generic_event_t *
+property(xcb_window_t window, xcb_atom_t atom)
+{
+  auto * e = make<xcb_property_notify_event_t>(XCB_PROPERTY_NOTIFY);
+  e->window = window;
+  e->atom = atom;
+  return reinterpret_cast<xcb_generic_event_t *>(e);
+}
+
+xcb_generic_event_t *
+key_press(xcb_window_t window)
+{
+  auto * e = make<xcb_key_press_event_t>(XCB_KEY_PRESS);
+  e->event = window;
+  return reinterpret_cast<xcb_generic_event_t *>(e);
+}
+
+const xcb_expose_event_t &
+as_expose(const xcb_generic_event_t & e)
+{
+  return reinterpret_cast<const xcb_expose_event_t &>(e);
+}
+
+// Only consecutive MotionNotify events of the same window are merged
+void
+test_motion(void)
+{
+  connection c;
+  c.m_queue = { motion(1, 1), motion(1, 2), motion(2, 3), motion(1, 4),
+                key_press(1), motion(1, 5), motion(1, 6) };
+
+  xpp::event::batch<connection &> b(c);
+  assert(b.wait() == 7);
+  assert(b.coalesced() == 2);
+
+  registry r;
+  b.dispatch(r);
+  assert(r.m_events.size() == 5);
+  auto x = [&](std::size_t i)
+  {
+    return reinterpret_cast<xcb_motion_notify_event_t &>(r.m_events[i]).event_x;
+  };
+  assert(x(0) == 2 && x(1) == 3 && x(2) == 4 && x(4) == 6);
+  assert(r.m_events[3].response_type == XCB_KEY_PRESS);
+  assert(b.size() == 0 && b.coalesced() == 0);
+}
+
+// Overlapping rectangles of a window are merged, also transitively, and the
+// counts follow the remaining events
+void
+test_expose(void)
+{
+  connection c;
+  c.m_queue = { expose(1, 0, 0, 10, 10, 4),
+                expose(2, 0, 0, 10, 10, 1),
+                expose(1, 100, 100, 10, 10, 3),
+                expose(1, 20, 0, 10, 10, 2),
+                // bridges the first and the previous one
+                expose(1, 5, 0, 20, 5, 1),
+                expose(1, 200, 200, 1, 1, 0),
+                expose(2, 50, 50, 1, 1, 0) };
+
+  xpp::event::batch<connection &> b(c);
+  b.wait();
+  assert(b.coalesced() == 2);
+
+  std::vector<xcb_expose_event_t> events;
+  for (auto & e : b) {
+    events.push_back(as_expose(*e));
+  }
+  assert(events.size() == 5);
+
+  // window 1: (100, 100), merged (0, 0, 30, 10), (200, 200)
+  assert(events[1].window == 1 && events[1].x == 100 && events[1].count == 2);
+  assert(events[2].window == 1 && events[2].x == 0 && events[2].y == 0
+         && events[2].width == 30 && events[2].height == 10
+         && events[2].count == 1);
+  assert(events[3].window == 1 && events[3].count == 0);
+
+  // window 2 is untouched
+  assert(events[0].window == 2 && events[0].count == 1);
+  assert(events[4].window == 2 && events[4].count == 0);
+}
+
+// Repeated PropertyNotify events of a (window, atom) keep the last one
+void
+test_property(void)
+{
+  connection c;
+  c.m_queue = { property(1, 10), property(1, 11), property(2, 10),
+                property(1, 10), property(1, 10) };
+
+  xpp::event::batch<connection &> b(c);
+  b.wait();
+  assert(b.coalesced() == 2);
+  assert(b.size() == 3);
+
+  auto e = b.begin();
+  auto p = [](const xpp::generic::event_ptr & e)
+  {
+    return reinterpret_cast<const xcb_property_notify_event_t *>(e.get());
+  };
+  assert(p(*e)->window == 1 && p(*e)->atom == 11); ++e;
+  assert(p(*e)->window == 2 && p(*e)->atom == 10); ++e;
+  assert(p(*e)->window == 1 && p(*e)->atom == 10);
+}
+
+// Custom rules replace the defaults per response type
+void
+test_rules(void)
+{
+  connection c;
+  c.m_queue = { key_press(1), key_press(1), motion(1, 1), motion(1, 2) };
+
+  xpp::event::batch<connection &> b(c);
+  b.rules().reset(XCB_MOTION_NOTIFY);
+  b.rules().set(XCB_KEY_PRESS,
+      [](const xcb_generic_event_t *, xcb_generic_event_t *) { return true; });
+  b.wait();
+  assert(b.coalesced() == 1);
+  assert(b.size() == 3);
+}
+
+int main(int, char **)
+{
+  test_motion();
+  test_expose();
+  test_property();
+  test_rules();
+  std::cout << "batch: ok" << std::endl;
+  return 0;
+}
@@ -0,0 +1,169 @@
+#include <vector>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+#include "../../include/xpp/color_cache.hpp"
+
+// Setup data with one screen, each visual has its own depth
+static std::vector<uint8_t> g_setup;
+
+extern "C" {
+
+const xcb_setup_t *
+xcb_get_setup(xcb_connection_t *)
+{
+  return reinterpret_cast<const xcb_setup_t *>(g_setup.data());
+}
+
+} // extern "C"
+
+template<typename T>
+void
+append(const T & data)
+{
+  const auto * bytes = reinterpret_cast<const uint8_t *>(&data);
+  g_setup.insert(g_setup.end(), bytes, bytes + sizeof(T));
+}
+
+void
+make_setup(const std::vector<std::pair<uint8_t, xcb_visualtype_t>> & visuals)
+{
+  g_setup.clear();
+
+  xcb_setup_t setup = {};
+  setup.roots_len = 1;
+  append(setup);
+
+  xcb_screen_t screen = {};
+  screen.allowed_depths_len = visuals.size();
+  append(screen);
+
+  for (auto & visual : visuals) {
+    xcb_depth_t depth = {};
+    depth.depth = visual.first;
+    depth.visuals_len = 1;
+    append(depth);
+    append(visual.second);
+  }
+}
+
+xcb_visualtype_t
+visual(xcb_visualid_t id, uint8_t _class, uint8_t bits,
+       uint32_t red, uint32_t green, uint32_t blue)
+{
+  xcb_visualtype_t v = {};
+  v.visual_id = id;
+  v._class = _class;
+  v.bits_per_rgb_value = bits;
+  v.colormap_entries = 1 << bits;
+  v.red_mask = red;
+  v.green_mask = green;
+  v.blue_mask = blue;
+  return v;
+}
+
+typedef xpp::color_cache<xcb_connection_t *> cache;
+
+static xcb_connection_t * const c = reinterpret_cast<xcb_connection_t *>(1);
+
+void
+setup(void)
+{
+  make_setup({
+    { 24, visual(0x21, XCB_VISUAL_CLASS_TRUE_COLOR, 8,
+                 0xff0000, 0xff00, 0xff) },
+    { 16, visual(0x22, XCB_VISUAL_CLASS_TRUE_COLOR, 6, 0xf800, 0x7e0, 0x1f) },
+    { 32, visual(0x23, XCB_VISUAL_CLASS_TRUE_COLOR, 8,
+                 0xff0000, 0xff00, 0xff) },
+    { 30, visual(0x24, XCB_VISUAL_CLASS_TRUE_COLOR, 10,
+                 0x3ff00000, 0xffc00, 0x3ff) },
+    // channels in unusual order
+    { 24, visual(0x25, XCB_VISUAL_CLASS_TRUE_COLOR, 8,
+                 0xff, 0xff00, 0xff0000) },
+    { 8, visual(0x26, XCB_VISUAL_CLASS_PSEUDO_COLOR, 8, 0, 0, 0) },
+    { 24, visual(0x27, XCB_VISUAL_CLASS_DIRECT_COLOR, 8,
+                 0xff0000, 0xff00, 0xff) },
+  });
+}
+
+// 16 bit values are scaled to the channel and rounded to nearest. 8 bit
+// values scaled up by 257 come back unchanged.
+void
+test_24(void)
+{
+  cache colors(c, 1, 0x21);
+  assert(colors.local());
+
+  assert(colors.pixel(0, 0, 0) == 0);
+  assert(colors.pixel(0xffff, 0xffff, 0xffff) == 0xffffff);
+  assert(colors.pixel(0xffff, 0, 0) == 0xff0000);
+  assert(colors.pixel(0, 0xffff, 0) == 0xff00);
+  assert(colors.pixel(0, 0, 0xffff) == 0xff);
+  assert(colors.pixel(0x8000, 0x7fff, 0x0080) == 0x807f00);
+  assert(colors.pixel(0x0081, 0, 0) == 0x010000);
+
+  for (uint32_t v = 0; v <= 0xff; ++v) {
+    assert(colors.pixel(v * 257, v * 257, v * 257) == (v << 16 | v << 8 | v));
+  }
+
+  const std::vector<xcb_rgb_t> rgb = { { 0xffff, 0, 0, 0 },
+                                       { 0x1212, 0x3434, 0x5656, 0 } };
+  assert(colors.pixels(rgb) == std::vector<uint32_t>({ 0xff0000, 0x123456 }));
+}
+
+void
+test_565(void)
+{
+  cache colors(c, 1, 0x22);
+  assert(colors.pixel(0xffff, 0xffff, 0xffff) == 0xffff);
+  assert(colors.pixel(0xffff, 0, 0) == 0xf800);
+  assert(colors.pixel(0, 0xffff, 0) == 0x7e0);
+  assert(colors.pixel(0, 0, 0xffff) == 0x1f);
+  // 0x8000 * 31 / 0xffff is 15.5, 0x8000 * 63 / 0xffff is 31.5
+  assert(colors.pixel(0x8000, 0x8000, 0x8000) == (16 << 11 | 32 << 5 | 16));
+}
+
+// The bits outside of the channels of a 32 bit visual are alpha
+void
+test_32(void)
+{
+  cache colors(c, 1, 0x23);
+  assert(colors.pixel(0, 0, 0) == 0xff000000);
+  assert(colors.pixel(0xffff, 0, 0xffff) == 0xffff00ff);
+
+  // not for 30 bit visuals
+  cache deep(c, 1, 0x24);
+  assert(deep.pixel(0, 0, 0) == 0);
+  assert(deep.pixel(0xffff, 0xffff, 0xffff) == 0x3fffffff);
+  assert(deep.pixel(0, 0xffff, 0) == 0xffc00);
+  assert(deep.pixel(0x8000, 0, 0) == 0x200u << 20);
+}
+
+void
+test_bgr(void)
+{
+  cache colors(c, 1, 0x25);
+  assert(colors.pixel(0x1212, 0x3434, 0x5656) == 0x563412);
+}
+
+// PseudoColor and DirectColor need AllocColor
+void
+test_not_local(void)
+{
+  assert(! cache(c, 1, 0x26).local());
+  assert(! cache(c, 1, 0x27).local());
+  assert(! cache(c, 1, 0x99).local());
+}
+
+int main(int, char **)
+{
+  setup();
+  test_24();
+  test_565();
+  test_32();
+  test_bgr();
+  test_not_local();
+  std::cout << "color_cache: ok" << std::endl;
+  return 0;
+}
@@ -0,0 +1,104 @@
+#include <atomic>
+#include <thread>
+#include <cassert>
+#include <iostream>
+
+#include "../../include/xpp/generic/epoch.hpp"
+
+static int g_deleted = 0;
+
+struct object {
+  int m_value;
+
+  ~object(void)
+  {
+    ++g_deleted;
+  }
+};
+
+// Retired objects outlive the guards which were held when they were replaced
+void
+test_guard(void)
+{
+  g_deleted = 0;
+  {
+    xpp::generic::epoch e;
+    std::atomic<const object *> current { new object { 1 } };
+
+    {
+      const xpp::generic::epoch::guard guard(e);
+      const object * seen = current.load();
+
+      const object * old = current.exchange(new object { 2 });
+      e.retire(old);
+      assert(g_deleted == 0);
+      assert(seen->m_value == 1);
+
+      // still in use, however often the writer tries
+      old = current.exchange(new object { 3 });
+      e.retire(old);
+      e.retire<object>(nullptr);
+      assert(g_deleted == 0);
+    }
+
+    // both are freed once the reader left
+    e.retire<object>(nullptr);
+    assert(g_deleted == 2);
+
+    delete current.load();
+  }
+  assert(g_deleted == 3);
+}
+
+// Without readers objects are freed by the next retire()
+void
+test_no_readers(void)
+{
+  g_deleted = 0;
+  xpp::generic::epoch e;
+  for (int i = 0; i < 100; ++i) {
+    e.retire(new object { i });
+  }
+  assert(g_deleted == 100);
+}
+
+// Readers on other threads never see a freed object, run with
+// -fsanitize=address
+void
+test_threads(void)
+{
+  xpp::generic::epoch e;
+  std::atomic<const object *> current { new object { 0 } };
+  std::atomic<bool> stop { false };
+
+  std::thread readers[4];
+  for (auto & reader : readers) {
+    reader = std::thread([&]
+        {
+          while (! stop.load()) {
+            const xpp::generic::epoch::guard guard(e);
+            const object * o = current.load();
+            assert(o->m_value >= 0);
+          }
+        });
+  }
+
+  for (int i = 1; i < 100000; ++i) {
+    e.retire(current.exchange(new object { i }));
+  }
+
+  stop.store(true);
+  for (auto & reader : readers) {
+    reader.join();
+  }
+  delete current.load();
+}
+
+int main(int, char **)
+{
+  test_guard();
+  test_no_readers();
+  test_threads();
+  std::cout << "epoch: ok" << std::endl;
+  return 0;
+}
@@ -0,0 +1,147 @@
+#include <vector>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+#include "../../include/xpp/font_metrics.hpp"
+
+// A QueryFont reply as it comes off the wire: no properties, then the char
+// infos
+class reply
+{
+  public:
+    reply(uint8_t min_byte1, uint8_t max_byte1,
+          uint16_t min_char, uint16_t max_char, uint16_t default_char,
+          const std::vector<xcb_charinfo_t> & char_infos)
+      : m_data(sizeof(xcb_query_font_reply_t)
+               + char_infos.size() * sizeof(xcb_charinfo_t))
+    {
+      auto * r = get();
+      r->min_byte1 = min_byte1;
+      r->max_byte1 = max_byte1;
+      r->min_char_or_byte2 = min_char;
+      r->max_char_or_byte2 = max_char;
+      r->default_char = default_char;
+      r->font_ascent = 12;
+      r->font_descent = 3;
+      r->char_infos_len = char_infos.size();
+      if (! char_infos.empty()) {
+        std::memcpy(m_data.data() + sizeof(xcb_query_font_reply_t),
+                    char_infos.data(),
+                    char_infos.size() * sizeof(xcb_charinfo_t));
+      }
+    }
+
+    xcb_query_font_reply_t *
+    get(void)
+    {
+      return reinterpret_cast<xcb_query_font_reply_t *>(m_data.data());
+    }
+
+  private:
+    std::vector<uint8_t> m_data;
+};
+
+xcb_charinfo_t
+ci(int16_t left, int16_t right, int16_t width, int16_t ascent, int16_t descent)
+{
+  return xcb_charinfo_t { left, right, width, ascent, descent, 0 };
+}
+
+// 'a' to 'e', 'c' does not exist
+const std::vector<xcb_charinfo_t> g_abcde = {
+  ci(-1, 5, 6, 7, 2),
+  ci(1, 9, 8, 10, 0),
+  ci(0, 0, 0, 0, 0),
+  ci(0, 4, 5, 5, 3),
+  ci(2, 3, 4, 1, 1),
+};
+
+void
+check(const xpp::text_extents & e, int16_t ascent, int16_t descent,
+      int32_t width, int32_t left, int32_t right)
+{
+  assert(e.m_font_ascent == 12 && e.m_font_descent == 3);
+  assert(e.m_overall_ascent == ascent);
+  assert(e.m_overall_descent == descent);
+  assert(e.m_overall_width == width);
+  assert(e.m_overall_left == left);
+  assert(e.m_overall_right == right);
+}
+
+// Bearings are relative to the origin of the string, ascent and descent are
+// the largest of all characters
+void
+test_extents(void)
+{
+  reply r(0, 0, 'a', 'e', 'e', g_abcde);
+  xpp::font_metrics m(r.get());
+
+  assert(m.ascent() == 12 && m.descent() == 3);
+  assert(m.char_info(0, 'b')->character_width == 8);
+  assert(m.char_info(0, 'c') == nullptr);
+  assert(m.char_info(0, 'f') == nullptr);
+  assert(m.char_info(1, 'a') == nullptr);
+
+  check(m.extents(""), 0, 0, 0, 0, 0);
+  check(m.extents("a"), 7, 2, 6, -1, 5);
+  check(m.extents("ab"), 10, 2, 14, -1, 15);
+  // 'c' is drawn as the default character 'e'
+  check(m.extents("bca"), 10, 2, 18, 1, 17);
+  check(m.extents("z"), 1, 1, 4, 2, 3);
+  assert(m.width("bca") == 18);
+}
+
+// Without a default character missing characters are ignored
+void
+test_no_default(void)
+{
+  reply r(0, 0, 'a', 'e', 0, g_abcde);
+  xpp::font_metrics m(r.get());
+
+  check(m.extents("zaz"), 7, 2, 6, -1, 5);
+  check(m.extents("c"), 0, 0, 0, 0, 0);
+  assert(m.width("zcz") == 0);
+  // bytes above 0x7f are not negative
+  assert(m.width("\xe1") == 0);
+}
+
+// Rows of byte1, columns of byte2
+void
+test_matrix(void)
+{
+  reply r(1, 2, 0x10, 0x11, 0, { ci(0, 1, 1, 1, 0), ci(0, 2, 2, 1, 0),
+                                 ci(0, 3, 3, 1, 0), ci(0, 4, 4, 1, 0) });
+  xpp::font_metrics m(r.get());
+
+  assert(m.char_info(1, 0x11)->character_width == 2);
+  assert(m.char_info(2, 0x10)->character_width == 3);
+  assert(m.char_info(0, 0x10) == nullptr);
+  assert(m.char_info(2, 0x12) == nullptr);
+
+  const xcb_char2b_t text[] = { { 2, 0x11 }, { 1, 0x10 }, { 3, 0 } };
+  check(m.extents(text, 3), 1, 0, 5, 0, 5);
+  assert(m.width(text, 3) == 5);
+}
+
+// Without char infos all characters are min_bounds
+void
+test_min_bounds(void)
+{
+  reply r(0, 0, 0x20, 0x7e, 0, {});
+  r.get()->min_bounds = ci(0, 6, 7, 9, 2);
+  xpp::font_metrics m(r.get());
+
+  check(m.extents("abc"), 9, 2, 21, 0, 20);
+  assert(m.width("\x01") == 0);
+}
+
+int main(int, char **)
+{
+  test_extents();
+  test_no_default();
+  test_matrix();
+  test_min_bounds();
+  std::cout << "font_metrics: ok" << std::endl;
+  return 0;
+}
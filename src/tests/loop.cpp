@@ -0,0 +1,226 @@
+#include <map>
+#include <deque>
+#include <vector>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <sys/socket.h>
+
+#include "../../include/xpp/event/loop.hpp"
+
+xcb_generic_event_t *
+make(uint8_t response_type)
+{
+  auto * event = static_cast<xcb_generic_event_t *>(
+      std::calloc(1, sizeof(xcb_generic_event_t)));
+  event->response_type = response_type;
+  return event;
+}
+
+// Like libxcb, flush() may read events into the queue without the socket
+// ever becoming readable for epoll. Special queues are identified by their
+// event id.
+struct connection {
+  int m_fds[2];
+  std::deque<xcb_generic_event_t *> m_queue;
+  // put on the queue by the next flush()
+  std::deque<xcb_generic_event_t *> m_read_by_flush;
+  unsigned int m_flushes = 0;
+  std::map<uintptr_t, std::deque<xcb_generic_event_t *>> m_special;
+  std::deque<std::pair<uintptr_t, xcb_generic_event_t *>> m_special_by_flush;
+  unsigned int m_special_polls = 0;
+
+  connection(void)
+  {
+    assert(::socketpair(AF_UNIX, SOCK_STREAM, 0, m_fds) == 0);
+  }
+
+  ~connection(void)
+  {
+    for (auto * event : m_queue) {
+      std::free(event);
+    }
+    for (auto * event : m_read_by_flush) {
+      std::free(event);
+    }
+    for (auto & queue : m_special) {
+      for (auto * event : queue.second) {
+        std::free(event);
+      }
+    }
+    for (auto & event : m_special_by_flush) {
+      std::free(event.second);
+    }
+    ::close(m_fds[0]);
+    ::close(m_fds[1]);
+  }
+
+  int
+  get_file_descriptor(void) const
+  {
+    return m_fds[0];
+  }
+
+  void
+  flush(void)
+  {
+    ++m_flushes;
+    if (! m_read_by_flush.empty()) {
+      m_queue.push_back(m_read_by_flush.front());
+      m_read_by_flush.pop_front();
+    }
+    if (! m_special_by_flush.empty()) {
+      auto & event = m_special_by_flush.front();
+      m_special[event.first].push_back(event.second);
+      m_special_by_flush.pop_front();
+    }
+  }
+
+  xpp::generic::event_ptr
+  poll_for_queued_event(void)
+  {
+    if (m_queue.empty()) {
+      return nullptr;
+    }
+    auto * event = m_queue.front();
+    m_queue.pop_front();
+    return xpp::generic::event_ptr(event);
+  }
+
+  xpp::generic::event_ptr
+  poll_for_event(void)
+  {
+    return poll_for_queued_event();
+  }
+
+  xcb_special_event_t *
+  register_for_special_xge(xcb_extension_t *, uint32_t eid, uint32_t *)
+  {
+    return reinterpret_cast<xcb_special_event_t *>(uintptr_t(eid));
+  }
+
+  void
+  unregister_for_special_event(xcb_special_event_t *)
+  {}
+
+  xpp::generic::event_ptr
+  poll_for_special_event(xcb_special_event_t * se)
+  {
+    ++m_special_polls;
+    auto & queue = m_special[reinterpret_cast<uintptr_t>(se)];
+    if (queue.empty()) {
+      return nullptr;
+    }
+    auto * event = queue.front();
+    queue.pop_front();
+    return xpp::generic::event_ptr(event);
+  }
+
+  void
+  check_connection(void)
+  {}
+};
+
+struct registry {
+  std::vector<uint8_t> m_events;
+
+  void
+  dispatch(const xpp::generic::event_ptr & event)
+  {
+    m_events.push_back(event->response_type);
+  }
+};
+
+typedef xpp::event::loop<connection &, registry> loop;
+
+// Events queued while flushing are dispatched before blocking
+void
+test_flush(void)
+{
+  connection c;
+  registry r;
+  loop l(c, r);
+
+  c.m_queue = { make(XCB_KEY_PRESS) };
+  c.m_read_by_flush = { make(XCB_KEY_RELEASE), make(XCB_EXPOSE) };
+
+  assert(l.run_once(0) == 3);
+  assert(r.m_events == std::vector<uint8_t>(
+        { XCB_KEY_PRESS, XCB_KEY_RELEASE, XCB_EXPOSE }));
+  assert(c.m_queue.empty() && c.m_read_by_flush.empty());
+
+  // nothing left, a single flush
+  c.m_flushes = 0;
+  assert(l.run_once(0) == 0);
+  assert(c.m_flushes == 1);
+}
+
+// Requests sent by handlers are flushed, and what that flush reads is
+// dispatched as well
+void
+test_handler_flush(void)
+{
+  connection c;
+  struct : registry {
+    connection * m_c;
+    void
+    dispatch(const xpp::generic::event_ptr & event)
+    {
+      registry::dispatch(event);
+      if (event->response_type == XCB_BUTTON_PRESS) {
+        m_c->m_read_by_flush.push_back(make(XCB_BUTTON_RELEASE));
+      }
+    }
+  } r;
+  r.m_c = &c;
+  xpp::event::loop<connection &, decltype(r)> l(c, r);
+
+  c.m_queue = { make(XCB_BUTTON_PRESS) };
+  c.m_read_by_flush = { make(XCB_BUTTON_PRESS) };
+
+  assert(l.run_once(0) == 4);
+  assert(r.m_events == std::vector<uint8_t>(
+        { XCB_BUTTON_PRESS, XCB_BUTTON_PRESS,
+          XCB_BUTTON_RELEASE, XCB_BUTTON_RELEASE }));
+}
+
+// Special events which a flush read are dispatched before blocking, idle
+// special queues are polled once per iteration
+void
+test_special(void)
+{
+  connection c;
+  registry r;
+  loop l(c, r);
+  xpp::event::special_queue<connection &> present(c, nullptr, 1);
+  xpp::event::special_queue<connection &> other(c, nullptr, 2);
+  l.add(present);
+  l.add(other);
+
+  c.m_special[1] = { make(XCB_GE_GENERIC) };
+  c.m_special_by_flush = { { 2, make(XCB_GE_GENERIC) },
+                           { 1, make(XCB_GE_GENERIC) } };
+  c.m_read_by_flush = { make(XCB_KEY_PRESS) };
+
+  assert(l.run_once(0) == 4);
+  assert(r.m_events == std::vector<uint8_t>(
+        { XCB_GE_GENERIC, XCB_GE_GENERIC, XCB_KEY_PRESS, XCB_GE_GENERIC }));
+
+  c.m_special_polls = 0;
+  assert(l.run_once(0) == 0);
+  assert(c.m_special_polls == 2);
+
+  l.remove(other);
+  c.m_special_polls = 0;
+  l.run_once(0);
+  assert(c.m_special_polls == 1);
+}
+
+int main(int, char **)
+{
+  test_flush();
+  test_handler_flush();
+  test_special();
+  std::cout << "loop: ok" << std::endl;
+  return 0;
+}
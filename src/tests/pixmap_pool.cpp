@@ -0,0 +1,295 @@
+#include <map>
+#include <set>
+#include <vector>
+#include <iterator>
+#include <cassert>
+#include <iostream>
+
+#include "../../include/xpp/pixmap_pool.hpp"
+
+// Pixmaps which exist on the fake server, by id
+struct pixmap {
+  uint8_t m_depth;
+  uint16_t m_width;
+  uint16_t m_height;
+};
+
+static std::map<xcb_pixmap_t, pixmap> g_pixmaps;
+static std::vector<xcb_pixmap_t> g_freed;
+static uint32_t g_next_id = 0x400000;
+// depth 24 and 32 have 32 bits per pixel, depth 8 has 8
+static std::vector<uint8_t> g_setup;
+
+extern "C" {
+
+uint32_t
+xcb_generate_id(xcb_connection_t *)
+{
+  return ++g_next_id;
+}
+
+const xcb_setup_t *
+xcb_get_setup(xcb_connection_t *)
+{
+  return reinterpret_cast<const xcb_setup_t *>(g_setup.data());
+}
+
+xcb_void_cookie_t
+xcb_create_pixmap(xcb_connection_t *, uint8_t depth, xcb_pixmap_t pid,
+                  xcb_drawable_t, uint16_t width, uint16_t height)
+{
+  assert(g_pixmaps.count(pid) == 0);
+  g_pixmaps[pid] = pixmap { depth, width, height };
+  return { 0 };
+}
+
+xcb_void_cookie_t
+xcb_create_pixmap_checked(xcb_connection_t * c, uint8_t depth,
+                          xcb_pixmap_t pid, xcb_drawable_t drawable,
+                          uint16_t width, uint16_t height)
+{
+  return xcb_create_pixmap(c, depth, pid, drawable, width, height);
+}
+
+xcb_void_cookie_t
+xcb_free_pixmap(xcb_connection_t *, xcb_pixmap_t pixmap)
+{
+  const std::size_t erased = g_pixmaps.erase(pixmap);
+  assert(erased == 1);
+  g_freed.push_back(pixmap);
+  return { 0 };
+}
+
+xcb_void_cookie_t
+xcb_free_pixmap_checked(xcb_connection_t * c, xcb_pixmap_t pixmap)
+{
+  return xcb_free_pixmap(c, pixmap);
+}
+
+} // extern "C"
+
+template<typename T>
+void
+append(const T & data)
+{
+  const auto * bytes = reinterpret_cast<const uint8_t *>(&data);
+  g_setup.insert(g_setup.end(), bytes, bytes + sizeof(T));
+}
+
+void
+reset(void)
+{
+  g_pixmaps.clear();
+  g_freed.clear();
+
+  g_setup.clear();
+  xcb_setup_t setup = {};
+  setup.pixmap_formats_len = 3;
+  append(setup);
+  for (uint8_t depth : { 8, 24, 32 }) {
+    xcb_format_t format = {};
+    format.depth = depth;
+    format.bits_per_pixel = depth == 8 ? 8 : 32;
+    format.scanline_pad = 32;
+    append(format);
+  }
+}
+
+typedef xpp::pixmap_pool<xcb_connection_t *> pool;
+
+static xcb_connection_t * const c = reinterpret_cast<xcb_connection_t *>(1);
+
+// Server memory of a 32 bits per pixel pixmap
+std::size_t
+bytes(uint16_t width, uint16_t height)
+{
+  return std::size_t(width) * 4 * height;
+}
+
+// Small sizes share one bucket, powers of two and their quarters are exact
+void
+test_exact(void)
+{
+  assert(pool::bucket(0) == 8);
+  assert(pool::bucket(1) == 8);
+  assert(pool::bucket(8) == 8);
+  assert(pool::bucket(9) == 10);
+  assert(pool::bucket(16) == 16);
+  assert(pool::bucket(17) == 20);
+  assert(pool::bucket(20) == 20);
+  assert(pool::bucket(21) == 24);
+  assert(pool::bucket(29) == 32);
+  assert(pool::bucket(1024) == 1024);
+  assert(pool::bucket(1025) == 1280);
+  assert(pool::bucket(1080) == 1280);
+  assert(pool::bucket(1792) == 1792);
+  assert(pool::bucket(1793) == 2048);
+  // clamped to the largest size of a pixmap
+  assert(pool::bucket(0xe001) == 0xffff);
+  assert(pool::bucket(0xffff) == 0xffff);
+}
+
+// For every size: large enough, at most 25% larger, a bucket maps to itself,
+// larger sizes never get smaller buckets, at most 4 buckets per power of two
+void
+test_all(void)
+{
+  uint32_t previous = 0;
+  std::set<uint32_t> buckets;
+
+  for (uint32_t value = 1; value <= 0xffff; ++value) {
+    const uint16_t b = pool::bucket(value);
+    assert(b >= value);
+    assert(value <= 8 || b == 0xffff || 4 * b <= 5 * value);
+    assert(pool::bucket(b) == b);
+    assert(b >= previous);
+    previous = b;
+    buckets.insert(b);
+  }
+
+  // besides the clamped one
+  buckets.erase(0xffff);
+  for (uint32_t low = 8; low <= 0x8000; low *= 2) {
+    auto first = buckets.lower_bound(low);
+    auto last = buckets.lower_bound(2 * low);
+    assert(std::distance(first, last) <= 4);
+  }
+}
+
+// A lease returns its pixmap to the pool, the next lease of the same bucket
+// gets it without a request
+void
+test_lease(void)
+{
+  reset();
+  pool p(c, 1, 1 << 20);
+
+  xcb_pixmap_t first = XCB_NONE;
+  {
+    auto lease = p.acquire(24, 100, 50);
+    first = *lease;
+    assert(lease.depth() == 24);
+    assert(lease.width() == 112 && lease.height() == 56);
+    assert(g_pixmaps.size() == 1);
+    assert(g_pixmaps[first].m_width == 112 && g_pixmaps[first].m_height == 56);
+    assert(p.misses() == 1 && p.hits() == 0);
+    assert(p.idle_bytes() == 0);
+  }
+  // idle, not freed
+  assert(g_pixmaps.size() == 1 && g_freed.empty());
+  assert(p.idle_bytes() == bytes(112, 56));
+
+  {
+    auto lease = p.acquire(24, 110, 56);
+    assert(*lease == first);
+    assert(p.hits() == 1 && p.misses() == 1);
+    assert(p.idle_bytes() == 0);
+
+    // the idle pixmap is in use, another one is created
+    auto other = p.acquire(24, 100, 50);
+    assert(*other != first);
+    assert(g_pixmaps.size() == 2);
+
+    // other depths are other buckets
+    auto deep = p.acquire(32, 100, 50);
+    assert(g_pixmaps.size() == 3);
+    assert(p.hits() == 1 && p.misses() == 3);
+
+    // a moved lease is given back once
+    pool::lease moved = std::move(other);
+    other = p.acquire(8, 8, 8);
+  }
+  assert(g_pixmaps.size() == 4 && g_freed.empty());
+  assert(p.idle_bytes() == 3 * bytes(112, 56) + 8 * 8);
+
+  p.clear();
+  assert(g_pixmaps.empty() && g_freed.size() == 4);
+  assert(p.idle_bytes() == 0);
+}
+
+// Idle pixmaps beyond the budget are freed least recently used first
+void
+test_evict(void)
+{
+  reset();
+  pool p(c, 1, 60000);
+
+  auto a = new pool::lease(p.acquire(24, 64, 64));
+  auto b = new pool::lease(p.acquire(24, 64, 80));
+  auto d = new pool::lease(p.acquire(24, 64, 96));
+  const xcb_pixmap_t pa = **a, pb = **b, pd = **d;
+  xcb_pixmap_t pc = XCB_NONE;
+  {
+    auto lease = p.acquire(24, 80, 64);
+    pc = *lease;
+  }
+  delete b;
+  delete a;
+  // most recently used first: a, b, c
+  assert(p.idle_bytes() == bytes(64, 64) + bytes(64, 80) + bytes(80, 64));
+  assert(p.evictions() == 0 && g_freed.empty());
+
+  // using c makes b the least recently used
+  {
+    auto lease = p.acquire(24, 80, 64);
+    assert(*lease == pc);
+  }
+
+  // 81920 bytes: b and a are freed
+  delete d;
+  assert(g_freed == std::vector<xcb_pixmap_t>({ pb, pa }));
+  assert(p.evictions() == 2);
+  assert(p.idle_bytes() == bytes(80, 64) + bytes(64, 96));
+  assert(p.idle_bytes() <= 60000);
+
+  {
+    auto lease = p.acquire(24, 64, 96);
+    assert(*lease == pd);
+    auto again = p.acquire(24, 64, 64);
+    assert(*again != pa);
+  }
+  assert(p.hits() == 2 && p.misses() == 5);
+
+  // a smaller budget evicts right away
+  p.budget(bytes(64, 96));
+  assert(p.evictions() == 4);
+  assert(p.idle_bytes() == bytes(64, 96));
+  assert(g_pixmaps.size() == 1 && g_pixmaps.count(pd) == 1);
+
+  // a pixmap larger than the budget is freed when it is given back
+  p.budget(0);
+  assert(g_pixmaps.empty());
+  {
+    auto lease = p.acquire(24, 10, 10);
+  }
+  assert(g_pixmaps.empty() && p.idle_bytes() == 0);
+  assert(p.evictions() == 6);
+}
+
+// Leases which outlive their pool free their pixmap, idle ones are freed
+// with the pool
+void
+test_destroy(void)
+{
+  reset();
+  pool::lease * lease = nullptr;
+  {
+    pool p(c, 1, 1 << 20);
+    lease = new pool::lease(p.acquire(24, 10, 10));
+    auto idle = p.acquire(24, 20, 20);
+  }
+  assert(g_pixmaps.size() == 1 && g_freed.size() == 1);
+  delete lease;
+  assert(g_pixmaps.empty() && g_freed.size() == 2);
+}
+
+int main(int, char **)
+{
+  test_exact();
+  test_all();
+  test_lease();
+  test_evict();
+  test_destroy();
+  std::cout << "pixmap_pool: ok" << std::endl;
+  return 0;
+}
@@ -0,0 +1,144 @@
+#include <string>
+#include <vector>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unistd.h> // getpid
+#include <xcb/bigreq.h>
+
+#include "../../include/xpp/generic/extension.hpp"
+#include "../../include/xpp/event/recorder.hpp"
+
+struct big_requests
+  : public xpp::generic::extension<big_requests, &xcb_big_requests_id>
+{
+  using base = xpp::generic::extension<big_requests, &xcb_big_requests_id>;
+  using base::base;
+};
+
+// not recorded
+xcb_extension_t missing_id = { "MISSING", 0 };
+
+struct missing
+  : public xpp::generic::extension<missing, &missing_id>
+{
+  using base = xpp::generic::extension<missing, &missing_id>;
+  using base::base;
+};
+
+// As libxcb returns them: 36 bytes, XGE events with their payload
+std::vector<std::vector<uint8_t>>
+make_events(void)
+{
+  std::vector<std::vector<uint8_t>> events;
+
+  for (uint32_t i = 0; i < 100; ++i) {
+    std::vector<uint8_t> event(sizeof(xcb_generic_event_t), 0);
+    auto * e = reinterpret_cast<xcb_key_press_event_t *>(event.data());
+    e->response_type = XCB_KEY_PRESS | (i % 2 ? 0x80 : 0);
+    e->event = 0x400000 + i;
+    reinterpret_cast<xcb_generic_event_t *>(e)->full_sequence = i;
+    events.push_back(event);
+  }
+
+  std::vector<uint8_t> ge(sizeof(xcb_generic_event_t) + 4 * 3, 0);
+  auto * e = reinterpret_cast<xcb_ge_generic_event_t *>(ge.data());
+  e->response_type = XCB_GE_GENERIC;
+  e->length = 3;
+  for (std::size_t i = sizeof(xcb_generic_event_t); i < ge.size(); ++i) {
+    ge[i] = i;
+  }
+  events.push_back(ge);
+
+  return events;
+}
+
+void
+test_round_trip(const std::string & path)
+{
+  const auto events = make_events();
+
+  xcb_query_extension_reply_t reply = {};
+  reply.present = 1;
+  reply.major_opcode = 133;
+
+  {
+    big_requests extension(&reply);
+    xpp::event::recorder recorder(path, extension);
+    for (auto & event : events) {
+      recorder(*reinterpret_cast<const xcb_generic_event_t *>(event.data()));
+    }
+  }
+
+  xpp::event::player player(path);
+
+  // the extension data of the recorded server
+  auto & recorded = player.connection().extension<big_requests>();
+  assert(recorded->present && recorded->major_opcode == 133);
+  assert(! player.connection().extension<missing>()->present);
+
+  std::chrono::nanoseconds last(0);
+  for (auto & expected : events) {
+    auto event = player.next();
+    assert(event);
+    assert(xpp::event::detail::event_size(*event) == expected.size());
+    assert(std::memcmp(event.get(), expected.data(), expected.size()) == 0);
+    assert(player.timestamp() >= last);
+    last = player.timestamp();
+  }
+  assert(! player.next());
+}
+
+// Registries get every remaining event
+void
+test_play(const std::string & path)
+{
+  struct registry {
+    mutable std::size_t m_events = 0;
+
+    bool
+    dispatch(const xpp::generic::event_ptr & event) const
+    {
+      ++m_events;
+      return event.get() != nullptr;
+    }
+  } r;
+
+  xpp::event::player player(path);
+  assert(player.next());
+  assert(player.play(r) == make_events().size() - 1);
+  assert(r.m_events == make_events().size() - 1);
+}
+
+void
+test_invalid(const std::string & path)
+{
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << "XPPEVREC";
+  }
+
+  bool thrown = false;
+  try {
+    xpp::event::player player(path);
+  } catch (const std::runtime_error &) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+int main(int, char **)
+{
+  const std::string path =
+    "/tmp/xpp-recorder-test-" + std::to_string(getpid());
+
+  test_round_trip(path);
+  test_play(path);
+  test_invalid(path);
+  std::remove(path.c_str());
+
+  std::cout << "recorder: ok" << std::endl;
+  return 0;
+}
@@ -0,0 +1,194 @@
+#include <vector>
+#include <cassert>
+#include <iostream>
+
+#include "../../include/xpp/setup_index.hpp"
+
+// Builds setup data as the server sends it
+class setup
+{
+  public:
+    struct depth {
+      uint8_t m_depth;
+      std::vector<xcb_visualtype_t> m_visuals;
+    };
+
+    struct screen {
+      xcb_window_t m_root;
+      std::vector<depth> m_depths;
+    };
+
+    setup(const std::vector<xcb_format_t> & formats,
+          const std::vector<screen> & screens)
+    {
+      xcb_setup_t s = {};
+      s.vendor_len = 5;
+      s.pixmap_formats_len = formats.size();
+      s.roots_len = screens.size();
+      append(s);
+      // the vendor is padded to 4 bytes
+      m_data.insert(m_data.end(), { 'x', 'p', 'p', '-', 't', 0, 0, 0 });
+
+      for (auto & format : formats) {
+        append(format);
+      }
+
+      for (auto & screen : screens) {
+        xcb_screen_t data = {};
+        data.root = screen.m_root;
+        data.allowed_depths_len = screen.m_depths.size();
+        append(data);
+        for (auto & depth : screen.m_depths) {
+          xcb_depth_t data = {};
+          data.depth = depth.m_depth;
+          data.visuals_len = depth.m_visuals.size();
+          append(data);
+          for (auto & visual : depth.m_visuals) {
+            append(visual);
+          }
+        }
+      }
+    }
+
+    const xcb_setup_t *
+    get(void) const
+    {
+      return reinterpret_cast<const xcb_setup_t *>(m_data.data());
+    }
+
+  private:
+    std::vector<uint8_t> m_data;
+
+    template<typename T>
+    void
+    append(const T & data)
+    {
+      const auto * bytes = reinterpret_cast<const uint8_t *>(&data);
+      m_data.insert(m_data.end(), bytes, bytes + sizeof(T));
+    }
+};
+
+xcb_visualtype_t
+visual(xcb_visualid_t id, uint8_t _class,
+       uint32_t red = 0xff0000, uint32_t green = 0xff00, uint32_t blue = 0xff)
+{
+  xcb_visualtype_t v = {};
+  v.visual_id = id;
+  v._class = _class;
+  v.red_mask = red;
+  v.green_mask = green;
+  v.blue_mask = blue;
+  return v;
+}
+
+xcb_format_t
+format(uint8_t depth, uint8_t bits_per_pixel)
+{
+  xcb_format_t f = {};
+  f.depth = depth;
+  f.bits_per_pixel = bits_per_pixel;
+  f.scanline_pad = 32;
+  return f;
+}
+
+const uint8_t true_color = XCB_VISUAL_CLASS_TRUE_COLOR;
+
+// Two screens: the first with a BGR and an ARGB visual at depth 32, the
+// second with only a BGR one
+const setup g_setup(
+  { format(1, 1), format(24, 32), format(32, 32) },
+  { { 0x100, { { 24, { visual(0x21, true_color),
+                       visual(0x22, XCB_VISUAL_CLASS_DIRECT_COLOR) } },
+               { 32, { visual(0x40, true_color, 0xff, 0xff00, 0xff0000),
+                       visual(0x41, true_color),
+                       visual(0x42, true_color) } },
+               { 8, {} } } },
+    { 0x200, { { 24, { visual(0x51, true_color) } },
+               { 32, { visual(0x61, XCB_VISUAL_CLASS_DIRECT_COLOR),
+                       visual(0x60, true_color, 0xff, 0xff00, 0xff0000),
+                       visual(0x5f, true_color, 0xff, 0xff00, 0xff0000) } }
+             } } });
+
+void
+test_screens(void)
+{
+  xpp::setup_index index(g_setup.get());
+
+  assert(index.screens() == 2);
+  assert(index.screen(0)->root == 0x100);
+  assert(index.screen(1)->root == 0x200);
+  assert(index.screen(2) == nullptr && index.screen(-1) == nullptr);
+
+  assert(index.screen_of_root(0x100) == 0);
+  assert(index.screen_of_root(0x200) == 1);
+  assert(index.screen_of_root(0x300) == -1);
+}
+
+// Visuals know their screen and depth, the pointers point into the setup
+void
+test_visuals(void)
+{
+  xpp::setup_index index(g_setup.get());
+
+  auto * v = index.visual(0x22);
+  assert(v && v->m_screen == 0 && v->m_depth == 24);
+  assert(v->m_visual->_class == XCB_VISUAL_CLASS_DIRECT_COLOR);
+  assert(reinterpret_cast<const uint8_t *>(v->m_visual)
+           > reinterpret_cast<const uint8_t *>(g_setup.get()));
+
+  v = index.visual(0x60);
+  assert(v && v->m_screen == 1 && v->m_depth == 32);
+  assert(index.visual(0x99) == nullptr);
+}
+
+// Of the 32 bit TrueColor visuals the lowest id of those with the ARGB masks,
+// otherwise the lowest id of any of them
+void
+test_argb(void)
+{
+  xpp::setup_index index(g_setup.get());
+
+  assert(index.argb_visual(0)->m_visual->visual_id == 0x41);
+  assert(index.argb_visual(1)->m_visual->visual_id == 0x5f);
+  assert(index.argb_visual(2) == nullptr);
+
+  const setup no_argb(
+    {}, { { 0x100, { { 24, { visual(0x21, true_color) } } } } });
+  xpp::setup_index none(no_argb.get());
+  assert(none.screens() == 1 && none.argb_visual(0) == nullptr);
+}
+
+void
+test_formats(void)
+{
+  xpp::setup_index index(g_setup.get());
+
+  assert(index.format(1)->bits_per_pixel == 1);
+  assert(index.format(24)->bits_per_pixel == 32);
+  assert(index.format(32)->scanline_pad == 32);
+  assert(index.format(8) == nullptr);
+}
+
+// A connection in error state has no setup
+void
+test_null(void)
+{
+  xpp::setup_index index(nullptr);
+  assert(index.screens() == 0);
+  assert(index.screen(0) == nullptr);
+  assert(index.screen_of_root(0x100) == -1);
+  assert(index.visual(0x21) == nullptr);
+  assert(index.argb_visual(0) == nullptr);
+  assert(index.format(24) == nullptr);
+}
+
+int main(int, char **)
+{
+  test_screens();
+  test_visuals();
+  test_argb();
+  test_formats();
+  test_null();
+  std::cout << "setup_index: ok" << std::endl;
+  return 0;
+}
@@ -0,0 +1,311 @@
+#include <vector>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include "../../include/xpp/socket_writer.hpp"
+
+// Stands in for xcb: records what is written to the socket and which replies
+// are discarded, calls the return_socket callback when xcb would need the
+// socket back
+struct request {
+  uint8_t m_opcode;
+  uint16_t m_length;
+  // as counted by the server
+  uint64_t m_sequence;
+};
+
+static uint64_t g_sequence;
+static std::vector<uint8_t> g_stream;
+static std::vector<request> g_requests;
+static std::vector<uint64_t> g_discarded;
+static unsigned int g_writes;
+static unsigned int g_iovecs;
+static bool g_fail;
+static void (*g_return_socket)(void *);
+static void * g_closure;
+static xcb_query_extension_reply_t g_extension;
+
+extern "C" {
+
+uint32_t
+xcb_get_maximum_request_length(xcb_connection_t *)
+{
+  // with BIG-REQUESTS
+  return 0x400000;
+}
+
+int
+xcb_connection_has_error(xcb_connection_t *)
+{
+  return g_fail ? XCB_CONN_ERROR : 0;
+}
+
+int
+xcb_take_socket(xcb_connection_t *, void (*return_socket)(void *),
+                void * closure, int, uint64_t * sent)
+{
+  g_return_socket = return_socket;
+  g_closure = closure;
+  *sent = g_sequence;
+  return 1;
+}
+
+int
+xcb_writev(xcb_connection_t *, struct iovec * vector, int count,
+           uint64_t requests)
+{
+  ++g_writes;
+  g_iovecs += count;
+  if (g_fail) {
+    return 0;
+  }
+
+  for (int i = 0; i < count; ++i) {
+    auto * base = static_cast<const uint8_t *>(vector[i].iov_base);
+    g_stream.insert(g_stream.end(), base, base + vector[i].iov_len);
+  }
+
+  // split into requests, only whole ones are written
+  std::size_t offset = 0;
+  while (offset < g_stream.size()) {
+    uint16_t length = 0;
+    std::memcpy(&length, &g_stream[offset + 2], sizeof(length));
+    assert(length > 0);
+    assert(offset + length * 4 <= g_stream.size());
+    g_requests.push_back(request { g_stream[offset], length, ++g_sequence });
+    offset += length * 4;
+    assert(requests-- > 0);
+  }
+  assert(requests == 0);
+  g_stream.clear();
+  return 1;
+}
+
+void
+xcb_discard_reply64(xcb_connection_t *, uint64_t sequence)
+{
+  g_discarded.push_back(sequence);
+}
+
+void
+xcb_discard_reply(xcb_connection_t *, unsigned int sequence)
+{
+  g_discarded.push_back(sequence);
+}
+
+xcb_get_input_focus_cookie_t
+xcb_get_input_focus(xcb_connection_t *)
+{
+  if (g_return_socket) {
+    auto * return_socket = g_return_socket;
+    g_return_socket = nullptr;
+    return_socket(g_closure);
+  }
+  g_requests.push_back(request { XCB_GET_INPUT_FOCUS, 1, ++g_sequence });
+  return { static_cast<unsigned int>(g_sequence) };
+}
+
+const xcb_query_extension_reply_t *
+xcb_get_extension_data(xcb_connection_t *, xcb_extension_t *)
+{
+  return &g_extension;
+}
+
+} // extern "C"
+
+static xcb_connection_t * const c = reinterpret_cast<xcb_connection_t *>(1);
+
+void
+reset(uint64_t sequence)
+{
+  g_sequence = sequence;
+  g_stream.clear();
+  g_requests.clear();
+  g_discarded.clear();
+  g_writes = 0;
+  g_iovecs = 0;
+  g_fail = false;
+  g_return_socket = nullptr;
+  g_extension = {};
+}
+
+// The first request after taking the socket is a GetInputFocus, whose reply
+// is discarded. Sequence numbers continue those of xcb.
+void
+test_take(void)
+{
+  reset(100);
+  {
+    xpp::socket_writer w(c);
+    const xcb_rectangle_t rectangles[2] = {};
+    assert(w.poly_fill_rectangle(1, 2, 2, rectangles) == 102);
+    assert(w.copy_area(1, 3, 2, 0, 0, 0, 0, 1, 1) == 103);
+    assert(w.sequence() == 103);
+    assert(g_writes == 0);
+
+    w.flush();
+    assert(g_writes == 1);
+    assert(g_requests.size() == 3);
+    assert(g_requests[0].m_opcode == XCB_GET_INPUT_FOCUS
+           && g_requests[0].m_sequence == 101);
+    assert(g_requests[1].m_opcode == XCB_POLY_FILL_RECTANGLE
+           && g_requests[1].m_length == 3 + 2 * 2
+           && g_requests[1].m_sequence == 102);
+    assert(g_requests[2].m_opcode == XCB_COPY_AREA
+           && g_requests[2].m_length == 7);
+    assert(g_discarded == std::vector<uint64_t>({ 101 }));
+  }
+  // given back on destruction, xcb sends another GetInputFocus
+  assert(g_requests.size() == 4 && g_requests[3].m_sequence == 104);
+  assert(g_discarded == std::vector<uint64_t>({ 101, 104 }));
+}
+
+// There are never more than 65534 requests without a reply in a row, and
+// every inserted GetInputFocus has its reply discarded
+void
+test_sync(void)
+{
+  reset(0xfff0);
+  xpp::socket_writer w(c, 1024);
+
+  const uint64_t n = 3 * 65536;
+  uint64_t sequence = 0;
+  for (uint64_t i = 0; i < n; ++i) {
+    const uint64_t s = w.copy_area(1, 2, 3, 0, 0, 0, 0, 1, 1);
+    assert(s > sequence);
+    sequence = s;
+  }
+  w.flush();
+
+  std::vector<uint64_t> syncs;
+  uint64_t reply = 0;
+  for (auto & r : g_requests) {
+    if (r.m_opcode == XCB_GET_INPUT_FOCUS) {
+      syncs.push_back(r.m_sequence);
+      reply = r.m_sequence;
+    } else {
+      assert(r.m_sequence - reply <= 65534);
+    }
+  }
+  assert(g_requests.size() == n + syncs.size());
+  assert(syncs.size() == 4);
+  assert(syncs[0] == 0xfff1);
+  assert(syncs[1] == 0xfff1 + 65535);
+  assert(g_discarded == syncs);
+
+  // the writer counted like the server
+  assert(w.sequence() == sequence && sequence == g_requests.back().m_sequence);
+  w.release();
+}
+
+// Requests larger than the buffer are written from the caller's data, padded
+void
+test_large(void)
+{
+  reset(0);
+  xpp::socket_writer w(c, 1024);
+
+  const std::vector<uint8_t> data(4001, 0xaa);
+  const uint8_t pixel[1] = { 0xbb };
+  w.put_image(XCB_IMAGE_FORMAT_Z_PIXMAP, 1, 2, 1, 1, 0, 0, 0, 24, 1, pixel);
+  assert(w.put_image(XCB_IMAGE_FORMAT_Z_PIXMAP, 1, 2, 1000, 1, 0, 0, 0, 8,
+                     data.size(), data.data()) == 3);
+  // the buffered requests and the large one in one write
+  assert(g_writes == 1 && g_iovecs == 3);
+  assert(g_requests.size() == 3);
+  assert(g_requests[1].m_length == (24 + 4) / 4);
+  assert(g_requests[2].m_length == (24 + 4004) / 4);
+
+  // BIG-REQUESTS encoding is not supported
+  const std::vector<uint8_t> huge(0x40000);
+  bool thrown = false;
+  try {
+    w.put_image(XCB_IMAGE_FORMAT_Z_PIXMAP, 1, 2, 0x100, 0x100, 0, 0, 0, 32,
+                huge.size(), huge.data());
+  } catch (const std::length_error &) {
+    thrown = true;
+  }
+  assert(thrown);
+  assert(w.sequence() == 3);
+  w.release();
+}
+
+// After release() the socket is taken again, continuing after the requests
+// xcb sent meanwhile
+void
+test_release(void)
+{
+  reset(10);
+  xpp::socket_writer w(c);
+  assert(w.copy_area(1, 2, 3, 0, 0, 0, 0, 1, 1) == 12);
+  w.release();
+  assert(g_requests.size() == 3 && g_requests[2].m_sequence == 13);
+
+  // not owned, nothing is sent
+  w.release();
+  assert(g_requests.size() == 3);
+
+  // a request of another thread through xcb
+  ++g_sequence;
+  assert(w.copy_area(1, 2, 3, 0, 0, 0, 0, 1, 1) == 16);
+  w.flush();
+  assert(g_requests[3].m_opcode == XCB_GET_INPUT_FOCUS
+         && g_requests[3].m_sequence == 15);
+  assert(g_discarded == std::vector<uint64_t>({ 11, 13, 15 }));
+  w.release();
+}
+
+void
+test_extension(void)
+{
+  reset(0);
+  xpp::socket_writer w(c);
+  xcb_extension_t extension = { "TEST", 0 };
+  xcb_copy_area_request_t r {};
+
+  bool thrown = false;
+  try {
+    w.request(&extension, r);
+  } catch (const std::runtime_error &) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  g_extension.present = 1;
+  g_extension.major_opcode = 140;
+  assert(w.request(&extension, r) == 2);
+  w.flush();
+  assert(g_requests.back().m_opcode == 140);
+  w.release();
+}
+
+void
+test_error(void)
+{
+  reset(0);
+  xpp::socket_writer w(c);
+  w.copy_area(1, 2, 3, 0, 0, 0, 0, 1, 1);
+
+  g_fail = true;
+  bool thrown = false;
+  try {
+    w.flush();
+  } catch (const xpp::connection_error &) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+int main(int, char **)
+{
+  test_take();
+  test_sync();
+  test_large();
+  test_release();
+  test_extension();
+  test_error();
+  std::cout << "socket_writer: ok" << std::endl;
+  return 0;
+}
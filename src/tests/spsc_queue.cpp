@@ -0,0 +1,91 @@
+#include <memory>
+#include <thread>
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+
+#include "../../include/xpp/generic/spsc_queue.hpp"
+
+void
+test_single_thread(void)
+{
+  xpp::generic::spsc_queue<int> q(5);
+  // rounded up to a power of two
+  assert(q.capacity() == 8);
+  assert(q.empty());
+
+  int value = -1;
+  assert(! q.pop(value) && value == -1);
+
+  // wraps around several times
+  for (int round = 0; round < 5; ++round) {
+    for (int i = 0; i < 8; ++i) {
+      assert(q.push(round * 8 + i));
+    }
+    assert(! q.push(-1));
+    assert(! q.empty());
+
+    for (int i = 0; i < 8; ++i) {
+      assert(q.pop(value) && value == round * 8 + i);
+    }
+    assert(! q.pop(value));
+    assert(q.empty());
+  }
+}
+
+// A rejected value is not moved from
+void
+test_full(void)
+{
+  xpp::generic::spsc_queue<std::unique_ptr<int>> q(1);
+  assert(q.push(std::unique_ptr<int>(new int(1))));
+
+  std::unique_ptr<int> value(new int(2));
+  assert(! q.push(std::move(value)));
+  assert(value && *value == 2);
+
+  std::unique_ptr<int> out;
+  assert(q.pop(out) && *out == 1);
+  assert(q.push(std::move(value)) && ! value);
+  assert(q.pop(out) && *out == 2);
+}
+
+// Everything pushed arrives exactly once and in order
+void
+test_threads(void)
+{
+  const uint64_t n = 1000000;
+  xpp::generic::spsc_queue<uint64_t> q(64);
+
+  std::thread producer([&]
+  {
+    for (uint64_t i = 1; i <= n; ++i) {
+      while (! q.push(i)) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  uint64_t expected = 1;
+  uint64_t value = 0;
+  while (expected <= n) {
+    if (q.pop(value)) {
+      assert(value == expected);
+      ++expected;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+
+  producer.join();
+  assert(q.empty());
+}
+
+int main(int, char **)
+{
+  test_single_thread();
+  test_full();
+  test_threads();
+  std::cout << "spsc_queue: ok" << std::endl;
+  return 0;
+}
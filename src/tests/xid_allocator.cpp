@@ -0,0 +1,274 @@
+#include <set>
+#include <deque>
+#include <string>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+#include "../../include/xpp/xid_allocator.hpp"
+
+// The allocator talks to the server only through these, replies to
+// GetXIDRange are scripted
+static xcb_setup_t g_setup;
+static uint32_t g_first;
+static xcb_query_extension_reply_t g_xc_misc;
+static std::deque<std::pair<uint32_t, uint32_t>> g_ranges;
+static unsigned int g_requests;
+static int g_error;
+
+xcb_extension_t xcb_xc_misc_id = { "XC-MISC", 0 };
+
+extern "C" {
+
+int
+xcb_connection_has_error(xcb_connection_t *)
+{
+  return g_error;
+}
+
+uint32_t
+xcb_generate_id(xcb_connection_t *)
+{
+  // like xcb for a connection in error state
+  return g_error ? -1 : g_first;
+}
+
+const xcb_setup_t *
+xcb_get_setup(xcb_connection_t *)
+{
+  return &g_setup;
+}
+
+const xcb_query_extension_reply_t *
+xcb_get_extension_data(xcb_connection_t *, xcb_extension_t *)
+{
+  return &g_xc_misc;
+}
+
+xcb_xc_misc_get_xid_range_cookie_t
+xcb_xc_misc_get_xid_range(xcb_connection_t *)
+{
+  return { ++g_requests };
+}
+
+xcb_xc_misc_get_xid_range_reply_t *
+xcb_xc_misc_get_xid_range_reply(xcb_connection_t *,
+                                xcb_xc_misc_get_xid_range_cookie_t,
+                                xcb_generic_error_t ** error)
+{
+  auto * reply = static_cast<xcb_xc_misc_get_xid_range_reply_t *>(
+      std::calloc(1, sizeof(xcb_xc_misc_get_xid_range_reply_t)));
+  reply->response_type = XCB_XC_MISC_GET_XID_RANGE;
+  // what a server without ids answers
+  reply->start_id = 0;
+  reply->count = 1;
+  if (! g_ranges.empty()) {
+    reply->start_id = g_ranges.front().first;
+    reply->count = g_ranges.front().second;
+    g_ranges.pop_front();
+  }
+  if (error) {
+    *error = nullptr;
+  }
+  return reply;
+}
+
+} // extern "C"
+
+static xcb_connection_t * const c = reinterpret_cast<xcb_connection_t *>(1);
+
+// 64 ids from 0x400000, xcb handed out the first 48 already
+void
+reset(void)
+{
+  g_setup.resource_id_base = 0x400000;
+  g_setup.resource_id_mask = 0x3f;
+  g_first = 0x400030;
+  g_xc_misc.present = 1;
+  g_ranges.clear();
+  g_requests = 0;
+  g_error = 0;
+}
+
+// Generates n ids, each must be new
+void
+generate(xpp::xid_allocator & a, std::set<uint32_t> & used, uint32_t n)
+{
+  for (uint32_t i = 0; i < n; ++i) {
+    const uint32_t xid = a.generate();
+    assert(used.insert(xid).second);
+  }
+}
+
+std::string
+exhaust(xpp::xid_allocator & a)
+{
+  try {
+    for (int i = 0; i < 1000000; ++i) {
+      a.generate();
+    }
+  } catch (const std::runtime_error & error) {
+    return error.what();
+  }
+  return "";
+}
+
+// A range is prefetched at low water and installed when the current one is
+// used up
+void
+test_prefetch(void)
+{
+  reset();
+  g_ranges = { { 0x400100, 32 } };
+
+  xpp::xid_allocator a(c, 4);
+  assert(a.available() == 16);
+
+  std::set<uint32_t> used;
+  generate(a, used, 11);
+  assert(g_requests == 0);
+  generate(a, used, 1);
+  assert(g_requests == 1);
+
+  generate(a, used, 4);
+  assert(*used.begin() == 0x400030 && *used.rbegin() == 0x40003f);
+  assert(a.generate() == 0x400100);
+  assert(a.available() == 31);
+  assert(g_requests == 1);
+}
+
+// Of a range which overlaps the current one, the larger part outside of it
+// is kept. A range inside of it is dropped and another one requested.
+void
+test_overlap(void)
+{
+  reset();
+  g_ranges = { { 0x400032, 4 },      // inside
+               { 0x400000, 0x48 } }; // 0x30 below, 8 above
+  {
+    xpp::xid_allocator a(c, 0);
+    std::set<uint32_t> used;
+    generate(a, used, 16 + 0x30);
+    assert(*used.begin() == 0x400000 && *used.rbegin() == 0x40003f);
+    // and the prefetch once the last range ran out
+    assert(g_requests == 3);
+  }
+
+  reset();
+  g_ranges = { { 0x400038, 0x20 } }; // 8 inside, 0x18 above
+  {
+    xpp::xid_allocator a(c, 0);
+    std::set<uint32_t> used;
+    generate(a, used, 16 + 0x18);
+    assert(*used.rbegin() == 0x400057);
+    assert(used.count(0x400038) == 1);
+  }
+}
+
+// Confirmed frees are reused when no range is pending. Freed ids which the
+// server hands out again in a range are only handed out from the range.
+void
+test_free(void)
+{
+  reset();
+  g_ranges = { { 0x400100, 8 }, { 0x400000, 0x38 } };
+
+  xpp::xid_allocator a(c, 4);
+  std::set<uint32_t> used;
+
+  a.release(0x400000);
+  a.confirm();
+  // no prefetch, there is a freed id
+  generate(a, used, 16);
+  assert(g_requests == 0);
+  assert(a.generate() == 0x400000);
+  assert(a.available() == 0);
+
+  generate(a, used, 8);
+  assert(*used.rbegin() == 0x400107);
+
+  // sent but not confirmed yet, not reused
+  a.release(0x400030);
+  a.release(0x400031);
+  assert(a.available() == 0);
+  // the prefetch for the range after 0x400100 is pending
+  assert(g_requests == 2);
+  a.confirm();
+  assert(a.available() == 2);
+
+  // the range contains the freed ids, they are not handed out twice
+  std::set<uint32_t> range;
+  generate(a, range, 0x38);
+  assert(*range.begin() == 0x400000 && *range.rbegin() == 0x400037);
+  assert(a.available() == 0);
+}
+
+// start_id 0 with count 1, or count 0, means the server has no ids left
+void
+test_exhausted(void)
+{
+  reset();
+  g_ranges = { { 0, 1 } };
+  {
+    xpp::xid_allocator a(c, 4);
+    assert(exhaust(a) == "xid_allocator: no resource ids left");
+    assert(g_requests == 1);
+  }
+
+  reset();
+  g_ranges = { { 0x400100, 0 } };
+  {
+    xpp::xid_allocator a(c, 4);
+    std::set<uint32_t> used;
+    generate(a, used, 16);
+    a.release(0x400030);
+    a.confirm();
+    // the freed id is left
+    assert(a.generate() == 0x400030);
+    assert(exhaust(a) == "xid_allocator: no resource ids left");
+  }
+}
+
+// Without XC-MISC nothing is requested, the range is used up first
+void
+test_no_xc_misc(void)
+{
+  reset();
+  g_xc_misc.present = 0;
+
+  xpp::xid_allocator a(c, 4);
+  std::set<uint32_t> used;
+  generate(a, used, 16);
+  const std::string error = exhaust(a);
+  assert(error.find("XC-MISC is not present") != std::string::npos);
+  assert(g_requests == 0);
+}
+
+// A connection in error state has no setup data to take ids from
+void
+test_connection_error(void)
+{
+  reset();
+  g_error = XCB_CONN_ERROR;
+
+  bool thrown = false;
+  try {
+    xpp::xid_allocator a(c);
+  } catch (const xpp::connection_error &) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+int main(int, char **)
+{
+  test_prefetch();
+  test_overlap();
+  test_free();
+  test_exhausted();
+  test_no_xc_misc();
+  test_connection_error();
+  std::cout << "xid_allocator: ok" << std::endl;
+  return 0;
+}
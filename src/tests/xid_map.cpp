@@ -0,0 +1,112 @@
+#include <map>
+#include <random>
+#include <cassert>
+#include <iostream>
+
+#include "../../include/xpp/generic/xid_map.hpp"
+
+typedef xpp::generic::xid_map<int> map;
+
+// Every key of reference is found with its value, nothing else is
+void
+check(const map & m, const std::map<uint32_t, int> & reference)
+{
+  assert(m.size() == reference.size());
+  assert(m.empty() == reference.empty());
+
+  for (auto & item : reference) {
+    const int * value = m.find(item.first);
+    assert(value && *value == item.second);
+  }
+
+  std::size_t n = 0;
+  m.for_each([&](uint32_t key, int value)
+             {
+               auto item = reference.find(key);
+               assert(item != reference.end() && item->second == value);
+               ++n;
+             });
+  assert(n == reference.size());
+}
+
+void
+test_basic(void)
+{
+  map m;
+  assert(m.empty() && m.find(1) == nullptr && ! m.erase(1));
+  // XCB_NONE is never a key
+  assert(m.find(0) == nullptr && ! m.erase(0));
+
+  m[0x200001] = 1;
+  m[0x200002] = 2;
+  ++m[0x200001];
+  assert(m.size() == 2 && *m.find(0x200001) == 2);
+  // default constructed on access
+  assert(m[0x200003] == 0 && m.size() == 3);
+
+  assert(m.erase(0x200002) && ! m.erase(0x200002));
+  assert(m.find(0x200002) == nullptr && m.size() == 2);
+
+  m.clear();
+  assert(m.empty() && m.find(0x200001) == nullptr);
+  m[7] = 7;
+  assert(*m.find(7) == 7);
+}
+
+// Consecutive ids of one client, as the server hands them out, across
+// several rehashes and with erasure in the middle of probe sequences
+void
+test_sequential(void)
+{
+  map m;
+  std::map<uint32_t, int> reference;
+  for (uint32_t xid = 0x1e00001; xid < 0x1e00001 + 5000; ++xid) {
+    m[xid] = xid & 0xffff;
+    reference[xid] = xid & 0xffff;
+  }
+  check(m, reference);
+
+  for (uint32_t xid = 0x1e00001; xid < 0x1e00001 + 5000; xid += 3) {
+    assert(m.erase(xid));
+    reference.erase(xid);
+  }
+  check(m, reference);
+}
+
+// Random operations against std::map. Few slots and clustered keys force
+// long probe sequences, which backward shift deletion has to keep intact.
+void
+test_random(void)
+{
+  std::mt19937 random(29);
+  map m;
+  std::map<uint32_t, int> reference;
+
+  for (int i = 0; i < 200000; ++i) {
+    const uint32_t key = 1 + random() % 512;
+    switch (random() % 3) {
+      case 0:
+      case 1:
+        m[key] = i;
+        reference[key] = i;
+        break;
+      case 2:
+        assert(m.erase(key) == (reference.erase(key) == 1));
+        break;
+    }
+
+    if (i % 997 == 0) {
+      check(m, reference);
+    }
+  }
+  check(m, reference);
+}
+
+int main(int, char **)
+{
+  test_basic();
+  test_sequential();
+  test_random();
+  std::cout << "xid_map: ok" << std::endl;
+  return 0;
+}